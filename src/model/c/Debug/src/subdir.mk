@@ -13,7 +13,16 @@ C_SRCS += \
 ../src/autogenerated_tests.c \
 ../src/bignum_uint32_t.c \
 ../src/montgomery_array.c \
-../src/montgomery_array_test.c
+../src/montgomery_array_test.c \
+../src/bignum_uint64_t.c \
+../src/montgomery_uint64_t.c \
+../src/montgomery_batch.c \
+../src/montgomery_ifma.c \
+../src/montgomery_adx.c \
+../src/montgomery_dispatch.c \
+../src/montgomery_crt.c \
+../src/montgomery_comb.c \
+../src/montgomery_pool.c
 
 OBJS += \
 ./src/ModExpTestBench.o \
@@ -21,7 +30,16 @@ OBJS += \
 ./src/autogenerated_tests.o \
 ./src/bignum_uint32_t.o \
 ./src/montgomery_array.o \
-./src/montgomery_array_test.o
+./src/montgomery_array_test.o \
+./src/bignum_uint64_t.o \
+./src/montgomery_uint64_t.o \
+./src/montgomery_batch.o \
+./src/montgomery_ifma.o \
+./src/montgomery_adx.o \
+./src/montgomery_dispatch.o \
+./src/montgomery_crt.o \
+./src/montgomery_comb.o \
+./src/montgomery_pool.o
 
 C_DEPS += \
 ./src/ModExpTestBench.d \
@@ -29,7 +47,16 @@ C_DEPS += \
 ./src/autogenerated_tests.d \
 ./src/bignum_uint32_t.d \
 ./src/montgomery_array.d \
-./src/montgomery_array_test.d
+./src/montgomery_array_test.d \
+./src/bignum_uint64_t.d \
+./src/montgomery_uint64_t.d \
+./src/montgomery_batch.d \
+./src/montgomery_ifma.d \
+./src/montgomery_adx.d \
+./src/montgomery_dispatch.d \
+./src/montgomery_crt.d \
+./src/montgomery_comb.d \
+./src/montgomery_pool.d
 
 
 # Each subdirectory must supply rules for building sources it contributes
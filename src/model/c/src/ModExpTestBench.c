@@ -8,7 +8,7 @@
 int main(void) {
   simple_tests();
 //  autogenerated_tests();
-//  montgomery_array_tests(0);
+  montgomery_array_tests(0);
 
   print_assert_array_stats();
 
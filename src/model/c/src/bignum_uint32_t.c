@@ -40,6 +40,16 @@ void copy_array(uint32_t length, uint32_t *src, uint32_t *dst) {
 		dst[i] = src[i];
 }
 
+// Swaps a and b if mask is all ones, leaves them if mask is zero,
+// without branching on mask.
+void cswap_array(uint32_t length, uint32_t mask, uint32_t *a, uint32_t *b) {
+	for (uint32_t i = 0; i < length; i++) {
+		uint32_t t = (a[i] ^ b[i]) & mask;
+		a[i] ^= t;
+		b[i] ^= t;
+	}
+}
+
 void add_array(uint32_t length, uint32_t *a, uint32_t *b, uint32_t *result) {
 	uint64_t carry = 0;
 	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--) {
@@ -66,6 +76,22 @@ void sub_array(uint32_t length, uint32_t *a, uint32_t *b, uint32_t *result) {
 	}
 }
 
+// t (2*length words) := a * b, schoolbook. t must not overlap a or b.
+void mul_array(uint32_t length, uint32_t *a, uint32_t *b, uint32_t *t) {
+	const int32_t n = (int32_t) length;
+	zero_array(2 * length, t);
+	for (int32_t i = n - 1; i >= 0; i--) {
+		uint64_t bi = b[i];
+		uint64_t carry = 0;
+		for (int32_t j = n - 1; j >= 0; j--) {
+			uint64_t r = a[j] * bi + t[i + j + 1] + carry;
+			t[i + j + 1] = (uint32_t) r;
+			carry = r >> 32;
+		}
+		t[i] = (uint32_t) carry;
+	}
+}
+
 void shift_right_1_array(uint32_t length, uint32_t *a, uint32_t *result) {
 	uint32_t prev = 0; // MSB will be zero extended
 	for (uint32_t wordIndex = 0; wordIndex < length; wordIndex++) {
@@ -94,20 +120,116 @@ void debugArray(char *msg, uint32_t length, uint32_t *array) {
 	printf("\n");
 }
 
-void modulus_array(uint32_t length, uint32_t *a, uint32_t *modulus, uint32_t *temp,
-		uint32_t *reminder) {
-	copy_array(length, a, reminder);
+// Word k, counting from the least significant end, of the length word
+// big endian number a. Words outside the number read as zero.
+static uint32_t word_le(uint32_t length, uint32_t *a, int32_t k) {
+	if ((k < 0) || (k >= (int32_t) length))
+		return 0;
+	return a[((int32_t) length) - 1 - k];
+}
+
+// Knuth's Algorithm D (TAOCP 4.3.1). quotient (alength words) := a / b and
+// reminder (blength words) := a mod b. b must be non zero. temp must hold
+// alength words and is used as the running remainder, so reminder may
+// overlap a. quotient may be NULL.
+//
+// Instead of shifting copies of a and b so that the divisor is normalized,
+// only the leading words used for the trial quotient are normalized on the
+// fly; the multiply and subtract step works on the unshifted numbers.
+void divmod_array(uint32_t alength, uint32_t *a, uint32_t blength, uint32_t *b,
+		uint32_t *quotient, uint32_t *reminder, uint32_t *temp) {
+	const int32_t m = (int32_t) alength;
+	int32_t n = (int32_t) blength;
+	while (n > 1 && word_le(blength, b, n - 1) == 0)
+		n--;
 
-	while (!greater_than_array(length, modulus, reminder)) {
+	copy_array(alength, a, temp);
+	if (quotient != NULL)
+		zero_array(alength, quotient);
 
-		copy_array(length, modulus, temp);
+	if (n == 1) {
+		const uint64_t d = word_le(blength, b, 0);
+		uint64_t r = 0;
+		for (int32_t k = m - 1; k >= 0; k--) {
+			uint64_t cur = (r << 32) | temp[m - 1 - k];
+			if (quotient != NULL)
+				quotient[m - 1 - k] = (uint32_t) (cur / d);
+			r = cur % d;
+			temp[m - 1 - k] = 0;
+		}
+		if (m > 0)
+			temp[m - 1] = (uint32_t) r;
+	} else {
+		uint32_t s = 0;
+		uint32_t vtop = word_le(blength, b, n - 1);
+		while ((vtop & 0x80000000) == 0) {
+			vtop <<= 1;
+			s++;
+		}
+		// Normalized word k of a number x: (x_k << s) | (x_(k-1) >> (32 - s))
+#define NORM(hi, lo) (s ? (((hi) << s) | ((lo) >> (32 - s))) : (hi))
+		const uint64_t vn1 = NORM(word_le(blength, b, n - 1), word_le(blength, b, n - 2));
+		const uint64_t vn2 = NORM(word_le(blength, b, n - 2), word_le(blength, b, n - 3));
+
+		for (int32_t j = m - n; j >= 0; j--) {
+			// Window u_j .. u_(j+n) of the running remainder, u_m == 0.
+			uint32_t u0 = word_le(alength, temp, j + n);
+			uint32_t u1 = word_le(alength, temp, j + n - 1);
+			uint32_t u2 = word_le(alength, temp, j + n - 2);
+			uint32_t u3 = word_le(alength, temp, j + n - 3);
+			uint64_t num = ((uint64_t) NORM(u0, u1) << 32) | NORM(u1, u2);
+			uint64_t un2 = NORM(u2, u3);
 
-		while (((temp[0] & 0x80000000) == 0)
-				&& (!greater_than_array(length, temp, reminder))) {
-			sub_array(length, reminder, temp, reminder);
-			shift_left_1_array(length, temp, temp);
+			uint64_t qhat = num / vn1;
+			uint64_t rhat = num % vn1;
+			while ((qhat >> 32) || (qhat * vn2 > ((rhat << 32) | un2))) {
+				qhat--;
+				rhat += vn1;
+				if (rhat >> 32)
+					break;
+			}
+
+			// u_j .. u_(j+n) -= qhat * b
+			uint64_t carry = 0;
+			int64_t borrow = 0;
+			for (int32_t k = 0; k < n; k++) {
+				uint64_t p = qhat * word_le(blength, b, k) + carry;
+				carry = p >> 32;
+				int64_t t = (int64_t) temp[m - 1 - (j + k)] - borrow
+						- (int64_t) (p & 0xFFFFFFFFul);
+				temp[m - 1 - (j + k)] = (uint32_t) t;
+				borrow = t < 0;
+			}
+			int64_t t = (int64_t) u0 - borrow - (int64_t) carry;
+			if (j + n < m)
+				temp[m - 1 - (j + n)] = (uint32_t) t;
+
+			if (t < 0) {
+				// qhat was one too large, add b back.
+				qhat--;
+				carry = 0;
+				for (int32_t k = 0; k < n; k++) {
+					uint64_t r = (uint64_t) temp[m - 1 - (j + k)]
+							+ word_le(blength, b, k) + carry;
+					temp[m - 1 - (j + k)] = (uint32_t) r;
+					carry = r >> 32;
+				}
+				if (j + n < m)
+					temp[m - 1 - (j + n)] += (uint32_t) carry;
+			}
+			if (quotient != NULL)
+				quotient[m - 1 - j] = (uint32_t) qhat;
 		}
+#undef NORM
 	}
+
+	for (int32_t k = 0; k < (int32_t) blength; k++)
+		reminder[((int32_t) blength) - 1 - k] = word_le(alength, temp, k);
+}
+
+void modulus_array(uint32_t length, uint32_t *a, uint32_t *modulus, uint32_t *temp,
+		uint32_t *reminder) {
+	divmod_array(length, a, length, modulus, NULL, reminder, temp);
 }
 
 void zero_array(uint32_t length, uint32_t *a) {
@@ -115,6 +237,14 @@ void zero_array(uint32_t length, uint32_t *a) {
 		a[i] = 0;
 }
 
+// Words of a from its most significant non zero one, at least 1.
+uint32_t significant_length_array(uint32_t length, uint32_t *a) {
+	uint32_t i = 0;
+	while ((i + 1 < length) && (a[i] == 0))
+		i++;
+	return length - i;
+}
+
 int greater_than_array(uint32_t length, uint32_t *a, uint32_t *b) {
 	for (uint32_t i = 0; i < length; i++) {
 		if (a[i] > b[i])
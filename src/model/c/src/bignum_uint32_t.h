@@ -10,13 +10,18 @@
 
 void modulus_array(uint32_t length, uint32_t *a, uint32_t *modulus, uint32_t *temp,
 		uint32_t *reminder);
+void divmod_array(uint32_t alength, uint32_t *a, uint32_t blength, uint32_t *b,
+		uint32_t *quotient, uint32_t *reminder, uint32_t *temp);
 int greater_than_array(uint32_t length, uint32_t *a, uint32_t *b);
 void add_array(uint32_t length, uint32_t *a, uint32_t *b, uint32_t *result);
 void sub_array(uint32_t length, uint32_t *a, uint32_t *b, uint32_t *result);
+void mul_array(uint32_t length, uint32_t *a, uint32_t *b, uint32_t *t);
 void shift_right_1_array(uint32_t length, uint32_t *a, uint32_t *result);
 void shift_left_1_array(uint32_t length, uint32_t *a, uint32_t *result);
 void zero_array(uint32_t length, uint32_t *a);
+uint32_t significant_length_array(uint32_t length, uint32_t *a);
 void copy_array(uint32_t length, uint32_t *src, uint32_t *dst);
+void cswap_array(uint32_t length, uint32_t mask, uint32_t *a, uint32_t *b);
 void debugArray(char *msg, uint32_t length, uint32_t *array);
 void assertArrayEquals(uint32_t length, uint32_t *expected, uint32_t *actual);
 void print_assert_array_stats(void);
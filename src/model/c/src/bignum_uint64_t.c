@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bignum_uint64_t.h"
+
+// b (length64 limbs) := a (length big endian words), the one pass between
+// the two layouts. Words of a that do not fit in b are dropped, missing
+// ones read as zero.
+void array_to_u64(uint32_t length, uint32_t *a, uint32_t length64, uint64_t *b) {
+	for (uint32_t k = 0; k < length64; k++) {
+		uint64_t lo = (2 * k < length) ? a[length - 1 - 2 * k] : 0;
+		uint64_t hi = (2 * k + 1 < length) ? a[length - 2 - 2 * k] : 0;
+		b[k] = (hi << 32) | lo;
+	}
+}
+
+// a (length big endian words) := b (length64 limbs).
+void u64_to_array(uint32_t length64, uint64_t *b, uint32_t length, uint32_t *a) {
+	for (uint32_t k = 0; k < length; k++) {
+		uint64_t limb = (k / 2 < length64) ? b[k / 2] : 0;
+		a[length - 1 - k] = (uint32_t) (limb >> (32 * (k % 2)));
+	}
+}
+
+// Bit i of the length limb e.
+uint64_t bit_u64(uint32_t length, uint64_t *e, uint32_t i) {
+	return (i < 64 * length) ? (e[i / 64] >> (i % 64)) & 1 : 0;
+}
+
+// Number of significant bits of the length limb e, 0 for e == 0.
+uint32_t bits_u64(uint32_t length, uint64_t *e) {
+	for (int32_t k = ((int32_t) length) - 1; k >= 0; k--) {
+		if (e[k] != 0)
+			return 64 * (uint32_t) k + 64 - (uint32_t) __builtin_clzll(e[k]);
+	}
+	return 0;
+}
+
+void copy_u64(uint32_t length, uint64_t *src, uint64_t *dst) {
+	for (uint32_t i = 0; i < length; i++)
+		dst[i] = src[i];
+}
+
+void zero_u64(uint32_t length, uint64_t *a) {
+	for (uint32_t i = 0; i < length; i++)
+		a[i] = 0;
+}
+
+void cswap_u64(uint32_t length, uint64_t mask, uint64_t *a, uint64_t *b) {
+	for (uint32_t i = 0; i < length; i++) {
+		uint64_t t = (a[i] ^ b[i]) & mask;
+		a[i] ^= t;
+		b[i] ^= t;
+	}
+}
+
+#ifdef MONT_HAVE_UINT64
+
+// t (2*length limbs) := a * b, schoolbook.
+void mul_u64(uint32_t length, uint64_t *a, uint64_t *b, uint64_t *t) {
+	zero_u64(2 * length, t);
+	for (uint32_t i = 0; i < length; i++) {
+		uint128_t bi = b[i];
+		uint128_t carry = 0;
+		for (uint32_t j = 0; j < length; j++) {
+			uint128_t r = a[j] * bi + t[i + j] + carry;
+			t[i + j] = (uint64_t) r;
+			carry = r >> 64;
+		}
+		t[i + length] = (uint64_t) carry;
+	}
+}
+
+// t (2*length limbs) := a * a, the cross products once and doubled, as in
+// mont_sqr_u64_kernel.
+void sqr_u64(uint32_t length, uint64_t *a, uint64_t *t) {
+	zero_u64(2 * length, t);
+	for (uint32_t i = 0; i + 1 < length; i++) {
+		uint128_t ai = a[i];
+		uint128_t carry = 0;
+		for (uint32_t j = i + 1; j < length; j++) {
+			uint128_t r = ai * a[j] + t[i + j] + carry;
+			t[i + j] = (uint64_t) r;
+			carry = r >> 64;
+		}
+		t[i + length] = (uint64_t) carry;
+	}
+
+	uint64_t prev = 0;
+	for (uint32_t k = 0; k < 2 * length; k++) {
+		uint64_t tk = t[k];
+		t[k] = (tk << 1) | prev;
+		prev = tk >> 63;
+	}
+	uint128_t carry = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		uint128_t sq = (uint128_t) a[i] * a[i];
+		uint128_t r = t[2 * i] + (uint128_t) (uint64_t) sq + carry;
+		t[2 * i] = (uint64_t) r;
+		r = t[2 * i + 1] + (sq >> 64) + (r >> 64);
+		t[2 * i + 1] = (uint64_t) r;
+		carry = r >> 64;
+	}
+}
+
+// t := t + v for the vlength limb v aligned with the low end of the
+// tlength limb t, the carry running through the rest of t. Returns the
+// carry out of t.
+static uint64_t add_into_u64(uint32_t tlength, uint64_t *t, uint32_t vlength,
+		uint64_t *v) {
+	uint64_t carry = 0;
+	for (uint32_t k = 0; k < tlength; k++) {
+		uint128_t r = (uint128_t) t[k] + carry;
+		if (k < vlength)
+			r += v[k];
+		t[k] = (uint64_t) r;
+		carry = (uint64_t) (r >> 64);
+	}
+	return carry;
+}
+
+// d (hlength limbs) := |x - y| for the hlength limb x and the llength
+// limb y, llength <= hlength. Returns 1 if x < y. The sign is applied
+// with a mask, not a branch.
+static uint64_t sub_abs_u64(uint32_t hlength, uint64_t *x, uint32_t llength,
+		uint64_t *y, uint64_t *d) {
+	uint64_t borrow = 0;
+	for (uint32_t k = 0; k < hlength; k++) {
+		uint64_t yk = (k < llength) ? y[k] : 0;
+		uint64_t xk = x[k];
+		d[k] = xk - yk - borrow;
+		borrow = (xk < yk) | ((xk == yk) & borrow);
+	}
+	const uint64_t mask = 0 - borrow;
+	uint64_t carry = borrow;
+	for (uint32_t k = 0; k < hlength; k++) {
+		uint128_t r = (uint128_t) (d[k] ^ mask) + carry;
+		d[k] = (uint64_t) r;
+		carry = (uint64_t) (r >> 64);
+	}
+	return borrow;
+}
+
+// Scratch limbs needed by mul_karatsuba_u64 and sqr_karatsuba_u64 for
+// length limb operands.
+uint32_t mul_karatsuba_u64_scratch(uint32_t length) {
+	if (length < MUL_KARATSUBA_LIMBS)
+		return 0;
+	const uint32_t h = (length + 1) / 2;
+	return 6 * h + 1 + mul_karatsuba_u64_scratch(h);
+}
+
+// t (2*length limbs) := a * b, subtractive Karatsuba down to
+// MUL_KARATSUBA_LIMBS limbs and mul_u64, or sqr_u64 if square is set and
+// b == a, below. With a = a1:a0 and b = b1:b0, a0 and b0 the low h limbs,
+// the middle term is a0*b0 + a1*b1 - (a0 - a1)(b0 - b1); the differences
+// are formed as magnitudes and the sign applied with masks, so the
+// sequence of operations only depends on length. w holds
+// mul_karatsuba_u64_scratch limbs. t must not overlap a, b or w.
+static void karatsuba_u64(uint32_t length, uint64_t *a, uint64_t *b,
+		uint64_t *t, uint64_t *w, int square) {
+	if (length < MUL_KARATSUBA_LIMBS) {
+		if (square)
+			sqr_u64(length, a, t);
+		else
+			mul_u64(length, a, b, t);
+		return;
+	}
+	const uint32_t h = (length + 1) / 2;
+	const uint32_t l = length - h;
+	uint64_t *da = w;
+	uint64_t *db = w + h;
+	uint64_t *m = w + 2 * h;
+	uint64_t *mid = w + 4 * h;
+	uint64_t *next = w + 6 * h + 1;
+
+	// t := a1*b1 : a0*b0
+	karatsuba_u64(h, a, b, t, next, square);
+	karatsuba_u64(l, a + h, b + h, t + 2 * h, next, square);
+
+	// sign is 1 where (a0 - a1)(b0 - b1) = -m, i.e. m is added.
+	uint64_t sign = sub_abs_u64(h, a, l, a + h, da);
+	if (square) {
+		sign = 0;
+		karatsuba_u64(h, da, da, m, next, square);
+	} else {
+		sign ^= sub_abs_u64(h, b, l, b + h, db);
+		karatsuba_u64(h, da, db, m, next, square);
+	}
+
+	// mid := a0*b0 + a1*b1 -+ m, which is non negative and fits 2h+1 limbs.
+	zero_u64(2 * h + 1, mid);
+	add_into_u64(2 * h + 1, mid, 2 * h, t);
+	add_into_u64(2 * h + 1, mid, 2 * l, t + 2 * h);
+	const uint64_t mask = 0 - sign;
+	uint64_t carry = sign ^ 1;
+	for (uint32_t k = 0; k < 2 * h + 1; k++) {
+		uint64_t mk = (k < 2 * h) ? m[k] : 0;
+		uint128_t r = (uint128_t) mid[k] + (uint64_t) ~(mk ^ mask) + carry;
+		mid[k] = (uint64_t) r;
+		carry = (uint64_t) (r >> 64);
+	}
+
+	add_into_u64(2 * length - h, t + h, 2 * h + 1, mid);
+}
+
+void mul_karatsuba_u64(uint32_t length, uint64_t *a, uint64_t *b, uint64_t *t,
+		uint64_t *w) {
+	karatsuba_u64(length, a, b, t, w, 0);
+}
+
+void sqr_karatsuba_u64(uint32_t length, uint64_t *a, uint64_t *t, uint64_t *w) {
+	karatsuba_u64(length, a, a, t, w, 1);
+}
+
+#endif /* MONT_HAVE_UINT64 */
@@ -0,0 +1,49 @@
+/*
+ * bignum_uint64_t.h
+ *
+ *  64 bit limb counterparts of the bignum_uint32_t helpers, used by the
+ *  montgomery_uint64_t backend. Numbers are little endian arrays of
+ *  uint64_t, least significant limb at index 0, so that carries run
+ *  forwards through memory. array_to_u64 and u64_to_array convert from
+ *  and to the big endian uint32_t arrays. On a little endian host, a
+ *  little endian byte string of 8*length bytes, aligned for uint64_t, is
+ *  such an array as it is.
+ */
+
+#ifndef BIGNUM_UINT64_T_H_
+#define BIGNUM_UINT64_T_H_
+
+#include <stdint.h>
+
+#ifdef __SIZEOF_INT128__
+#define MONT_HAVE_UINT64 1
+__extension__ typedef unsigned __int128 uint128_t;
+#endif
+
+// Number of 64 bit limbs needed for length 32 bit words.
+#define U64_LENGTH(length) (((length) + 1) / 2)
+
+void array_to_u64(uint32_t length, uint32_t *a, uint32_t length64, uint64_t *b);
+void u64_to_array(uint32_t length64, uint64_t *b, uint32_t length, uint32_t *a);
+void copy_u64(uint32_t length, uint64_t *src, uint64_t *dst);
+void zero_u64(uint32_t length, uint64_t *a);
+void cswap_u64(uint32_t length, uint64_t mask, uint64_t *a, uint64_t *b);
+uint64_t bit_u64(uint32_t length, uint64_t *e, uint32_t i);
+uint32_t bits_u64(uint32_t length, uint64_t *e);
+
+#ifdef MONT_HAVE_UINT64
+
+// Operand length in limbs from which mul_karatsuba_u64 splits, picked by
+// benchmark against the schoolbook product.
+#define MUL_KARATSUBA_LIMBS 32
+
+void mul_u64(uint32_t length, uint64_t *a, uint64_t *b, uint64_t *t);
+void sqr_u64(uint32_t length, uint64_t *a, uint64_t *t);
+uint32_t mul_karatsuba_u64_scratch(uint32_t length);
+void mul_karatsuba_u64(uint32_t length, uint64_t *a, uint64_t *b, uint64_t *t,
+		uint64_t *w);
+void sqr_karatsuba_u64(uint32_t length, uint64_t *a, uint64_t *t, uint64_t *w);
+
+#endif /* MONT_HAVE_UINT64 */
+
+#endif /* BIGNUM_UINT64_T_H_ */
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "montgomery_adx.h"
+
+#ifdef MONT_HAVE_ADX
+
+#include <cpuid.h>
+
+int mont_adx_available(void) {
+	static int available = -1;
+	if (available < 0) {
+		unsigned int eax, ebx, ecx, edx;
+		available = __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)
+				&& (ebx & bit_BMI2) && (ebx & bit_ADX);
+	}
+	return available;
+}
+
+// T[0..N+1] += AP * B for the N limb AP, both little endian. The low
+// halves of the limb products are added on the carry flag (adcx) and the
+// high halves on the overflow flag (adox), so the two carry chains run
+// interleaved instead of one after the other. The loop only uses lea and
+// jrcxz, which leave both flags alone. The result is stored OFF bytes from
+// where it was read, -8 shifts it down one limb.
+#define ADX_ROW(N, AP, B, T, OFF) \
+	do { \
+		const uint64_t *a_ = (AP); \
+		uint64_t *t_ = (T); \
+		uint64_t n_ = (N); \
+		__asm__ volatile( \
+			"xorl %%r10d, %%r10d\n\t" \
+			"1:\n\t" \
+			"movq (%[t]), %%r8\n\t" \
+			"mulxq (%[a]), %%r9, %%r11\n\t" \
+			"adoxq %%r10, %%r8\n\t" \
+			"adcxq %%r9, %%r8\n\t" \
+			"movq %%r8, %c[o0](%[t])\n\t" \
+			"movq %%r11, %%r10\n\t" \
+			"leaq 8(%[a]), %[a]\n\t" \
+			"leaq 8(%[t]), %[t]\n\t" \
+			"leaq -1(%[n]), %[n]\n\t" \
+			"jrcxz 2f\n\t" \
+			"jmp 1b\n" \
+			"2:\n\t" \
+			"movl $0, %%r9d\n\t" \
+			"movq (%[t]), %%r8\n\t" \
+			"adoxq %%r10, %%r8\n\t" \
+			"adcxq %%r9, %%r8\n\t" \
+			"movq %%r8, %c[o0](%[t])\n\t" \
+			"movq 8(%[t]), %%r8\n\t" \
+			"adoxq %%r9, %%r8\n\t" \
+			"adcxq %%r9, %%r8\n\t" \
+			"movq %%r8, %c[o1](%[t])\n\t" \
+			: [a] "+r" (a_), [t] "+r" (t_), [n] "+c" (n_) \
+			: "d" (B), [o0] "i" (OFF), [o1] "i" ((OFF) + 8) \
+			: "r8", "r9", "r10", "r11", "cc", "memory"); \
+	} while (0)
+
+// CIOS Montgomery product, see mont_prod_cios_array, with one ADX_ROW for
+// A * B[i] and one for q * M, the latter also doing the division by 2^64.
+// t has a spare limb below it for the zero limb that division drops.
+// s may overlap A or B. lazy skips the final subtraction, see
+// mont_prod_lazy_u64.
+static inline void mont_prod_adx_row(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s, const int lazy) {
+	uint64_t buf[MONT_ADX_MAX_LIMBS + 3];
+	uint64_t *t = buf + 1;
+	for (uint32_t j = 0; j < length + 2; j++)
+		t[j] = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		ADX_ROW(length, A, B[i], t, 0);
+		ADX_ROW(length, M, t[0] * n0, t, -8);
+		t[length + 1] = 0;
+	}
+	if (lazy) {
+		for (uint32_t j = 0; j < length; j++)
+			s[j] = t[j];
+		return;
+	}
+
+	// s := t - M if t >= M, see mont_final_sub_array.
+	uint64_t borrow = 0;
+	for (uint32_t j = 0; j < length; j++) {
+		uint64_t m = M[j];
+		borrow = (t[j] < m) | ((t[j] == m) & borrow);
+	}
+	const uint64_t mask = 0 - (t[length] | (borrow ^ 1));
+	borrow = 0;
+	for (uint32_t j = 0; j < length; j++) {
+		uint64_t m = M[j] & mask;
+		uint64_t d = t[j] - m - borrow;
+		borrow = (t[j] < m) | ((t[j] == m) & borrow);
+		s[j] = d;
+	}
+}
+
+void mont_prod_adx(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+		uint64_t n0, uint64_t *s) {
+	mont_prod_adx_row(length, A, B, M, n0, s, 0);
+}
+
+void mont_prod_adx_lazy(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+		uint64_t n0, uint64_t *s) {
+	mont_prod_adx_row(length, A, B, M, n0, s, 1);
+}
+
+#endif /* MONT_HAVE_ADX */
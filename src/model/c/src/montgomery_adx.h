@@ -0,0 +1,31 @@
+/*
+ * montgomery_adx.h
+ *
+ *  x86-64 Montgomery product on 64 bit limbs with mulx/adcx/adox (BMI2 and
+ *  ADX), the same contract as mont_prod_u64, which uses it where the CPU
+ *  has both extensions.
+ */
+
+#ifndef MONTGOMERY_ADX_H_
+#define MONTGOMERY_ADX_H_
+
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MONT_HAVE_ADX 1
+#endif
+
+// Largest length in 64 bit limbs, 8192 bits plus a leading zero word.
+#define MONT_ADX_MAX_LIMBS (8192 / 64 + 1)
+
+#ifdef MONT_HAVE_ADX
+
+int mont_adx_available(void);
+void mont_prod_adx(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+		uint64_t n0, uint64_t *s);
+void mont_prod_adx_lazy(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+		uint64_t n0, uint64_t *s);
+
+#endif /* MONT_HAVE_ADX */
+
+#endif /* MONTGOMERY_ADX_H_ */
@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include "bignum_uint32_t.h"
 #include "montgomery_array.h"
+#include "montgomery_uint64_t.h"
+#include "montgomery_ifma.h"
+#include "montgomery_dispatch.h"
 
 void mont_prod_array(uint32_t length, uint32_t *A, uint32_t *B, uint32_t *M, uint32_t *s) {
 	zero_array(length, s);
@@ -31,6 +34,70 @@ void mont_prod_array(uint32_t length, uint32_t *A, uint32_t *B, uint32_t *M, uin
 	}
 }
 
+// Returns n0' = -M^-1 mod 2^32, the per-word reduction factor used by
+// mont_prod_cios_array. M must be odd.
+uint32_t mont_n0_array(uint32_t length, uint32_t *M) {
+	uint32_t m0 = M[length - 1];
+	uint32_t x = m0; // m0 * m0 == 1 mod 8, i.e. three correct bits.
+	for (int i = 0; i < 4; i++)
+		x *= 2 - m0 * x; // Newton step, doubles the number of correct bits.
+	return 0 - x;
+}
+
+// s := s - M if top:s >= M, else s. The comparison result is turned into a
+// mask instead of a branch so that the time does not depend on s.
+static void mont_final_sub_array(uint32_t length, uint32_t top, uint32_t *M,
+		uint32_t *s) {
+	uint64_t carry = 1;
+	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--)
+		carry = (carry + s[i] + (uint32_t) ~M[i]) >> 32;
+	uint32_t mask = 0 - (top | (uint32_t) carry);
+	carry = 1;
+	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--) {
+		uint64_t r = carry + s[i] + (uint32_t) ~(M[i] & mask);
+		s[i] = (uint32_t) r;
+		carry = r >> 32;
+	}
+}
+
+// Word serial (CIOS) Montgomery product s = A * B * 2^(-32*length) mod M.
+// Same R as mont_prod_array but one multiply-accumulate pass over A and
+// one over M per word of B instead of per bit. The result is fully
+// reduced (< M) given A, B < M. s must not overlap A or B. There are no
+// branches on operand values, so the time only depends on length.
+void mont_prod_cios_array(uint32_t length, uint32_t *A, uint32_t *B, uint32_t *M,
+		uint32_t n0, uint32_t *s) {
+	uint32_t top = 0; // Word above s[0], at most 1.
+	zero_array(length, s);
+	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--) {
+		// t := t + A * B[i]
+		uint64_t bi = B[i];
+		uint64_t carry = 0;
+		for (int32_t j = ((int32_t) length) - 1; j >= 0; j--) {
+			uint64_t r = A[j] * bi + s[j] + carry;
+			s[j] = (uint32_t) r;
+			carry = r >> 32;
+		}
+		uint64_t r = top + carry;
+		uint32_t t_n = (uint32_t) r;
+		uint32_t t_n1 = (uint32_t) (r >> 32);
+
+		// t := (t + q * M) / 2^32
+		uint64_t q = s[length - 1] * n0;
+		r = q * M[length - 1] + s[length - 1];
+		carry = r >> 32;
+		for (int32_t j = ((int32_t) length) - 2; j >= 0; j--) {
+			r = q * M[j] + s[j] + carry;
+			s[j + 1] = (uint32_t) r;
+			carry = r >> 32;
+		}
+		r = t_n + carry;
+		s[0] = (uint32_t) r;
+		top = t_n1 + (uint32_t) (r >> 32);
+	}
+	mont_final_sub_array(length, top, M, s);
+}
+
 void m_residue_2_2N_array(uint32_t length, uint32_t N, uint32_t *M, uint32_t *temp,
 		uint32_t *Nr) {
 	zero_array(length, Nr);
@@ -43,16 +110,212 @@ void m_residue_2_2N_array(uint32_t length, uint32_t N, uint32_t *M, uint32_t *te
 	// Nr = (2 ** 2N) mod M
 }
 
+// s := s * 2^(-32*length) mod M in place, i.e. MontProd( s, 1, M ) without
+// the multiplication by one. s must be < M on entry.
+void mont_redc_array(uint32_t length, uint32_t *M, uint32_t n0, uint32_t *s) {
+	uint32_t top = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		uint64_t q = s[length - 1] * n0;
+		uint64_t r = q * M[length - 1] + s[length - 1];
+		uint64_t carry = r >> 32;
+		for (int32_t j = ((int32_t) length) - 2; j >= 0; j--) {
+			r = q * M[j] + s[j] + carry;
+			s[j + 1] = (uint32_t) r;
+			carry = r >> 32;
+		}
+		r = top + carry;
+		s[0] = (uint32_t) r;
+		top = (uint32_t) (r >> 32);
+	}
+	mont_final_sub_array(length, top, M, s);
+}
+
+// s := t * 2^(-32*length) mod M for a 2*length word t < M * R, which is
+// destroyed. s may overlap the first length words of t.
+void mont_redc_wide_array(uint32_t length, uint32_t *M, uint32_t n0, uint32_t *t,
+		uint32_t *s) {
+	const int32_t n = (int32_t) length;
+	uint32_t *lo = t + n; // Least significant half, lo[n - 1] is word 0.
+	uint64_t carry2 = 0; // Carry into word i + length of t.
+	for (int32_t i = 0; i < n; i++) {
+		uint64_t q = lo[n - 1 - i] * n0;
+		uint64_t carry = 0;
+		for (int32_t j = 0; j < n; j++) {
+			uint64_t r = q * M[n - 1 - j] + t[2 * n - 1 - (i + j)] + carry;
+			t[2 * n - 1 - (i + j)] = (uint32_t) r;
+			carry = r >> 32;
+		}
+		uint64_t r = t[n - 1 - i] + carry + carry2;
+		t[n - 1 - i] = (uint32_t) r;
+		carry2 = r >> 32;
+	}
+	copy_array(length, t, s);
+	mont_final_sub_array(length, (uint32_t) carry2, M, s);
+}
+
+// Montgomery squaring s := A * A * 2^(-32*length) mod M. The full square
+// is built in t (2*length words) computing each cross product a_i * a_j,
+// i < j, once and doubling them, before a separate REDC. That is about
+// 1.5 instead of 2 length^2 word products. s may overlap A.
+void mont_sqr_array(uint32_t length, uint32_t *A, uint32_t *M, uint32_t n0,
+		uint32_t *t, uint32_t *s) {
+	const int32_t n = (int32_t) length;
+	zero_array(2 * length, t);
+
+	// t := sum a_i * a_j * W^(i+j), i < j
+	for (int32_t i = 0; i < n - 1; i++) {
+		uint64_t ai = A[n - 1 - i];
+		uint64_t carry = 0;
+		for (int32_t j = i + 1; j < n; j++) {
+			uint64_t r = ai * A[n - 1 - j] + t[2 * n - 1 - (i + j)] + carry;
+			t[2 * n - 1 - (i + j)] = (uint32_t) r;
+			carry = r >> 32;
+		}
+		t[2 * n - 1 - (i + n)] = (uint32_t) carry;
+	}
+
+	// t := 2 * t + sum a_i^2 * W^(2i)
+	shift_left_1_array(2 * length, t, t);
+	uint64_t carry = 0;
+	for (int32_t i = 0; i < n; i++) {
+		uint64_t sq = (uint64_t) A[n - 1 - i] * A[n - 1 - i];
+		uint64_t r = t[2 * n - 1 - 2 * i] + (sq & 0xFFFFFFFFul) + carry;
+		t[2 * n - 1 - 2 * i] = (uint32_t) r;
+		r = t[2 * n - 2 - 2 * i] + (sq >> 32) + (r >> 32);
+		t[2 * n - 2 - 2 * i] = (uint32_t) r;
+		carry = r >> 32;
+	}
+
+	mont_redc_wide_array(length, M, n0, t, s);
+}
+
+// x := 2 * x mod M, x < M, with the subtraction of M under a mask.
+static void mod_double_array(uint32_t length, uint32_t *M, uint32_t *x) {
+	uint32_t carry = x[0] >> 31;
+	shift_left_1_array(length, x, x);
+	mont_final_sub_array(length, carry, M, x);
+}
+
+// r := 2^e mod M for odd M. R mod M is found by masked doublings from the
+// highest power of two below M, after which r holds 2^j in the Montgomery
+// domain (2^j * R mod M) for j = 0. Walking the bits of e from the top, a
+// Montgomery squaring doubles j and a modular doubling adds one, so only
+// log2(e) products are needed. A final REDC leaves 2^e mod M. Nothing
+// branches on the value of M or r, the time only depends on length, e and
+// the bit length of M, so M may be a secret prime of a known size. temp
+// holds length words.
+void mod_pow2_array(uint32_t length, uint32_t *M, uint32_t e, uint32_t *temp,
+		uint32_t *r) {
+	const uint32_t n0 = mont_n0_array(length, M);
+
+	// r := 2^(bits(M) - 1), the largest power of two not above M.
+	uint32_t top_word = 0;
+	while (top_word < length - 1 && M[top_word] == 0)
+		top_word++;
+	uint32_t top_bit = 31;
+	while (top_bit > 0 && ((M[top_word] >> top_bit) & 1) == 0)
+		top_bit--;
+	zero_array(length, r);
+	r[top_word] = 1u << top_bit;
+	mont_final_sub_array(length, 0, M, r); // M == 1
+
+	// r := R mod M
+	const uint32_t bits = 32 * (length - top_word) - (31 - top_bit);
+	for (uint32_t i = bits - 1; i < 32 * length; i++)
+		mod_double_array(length, M, r);
+
+	for (int32_t i = 31; i >= 0; i--) {
+		if ((e >> i) == 0)
+			continue;
+		mont_prod_cios_array(length, r, r, M, n0, temp);
+		copy_array(length, temp, r);
+		if ((e >> i) & 1)
+			mod_double_array(length, M, r);
+	}
+
+	mont_redc_array(length, M, n0, r);
+}
+
+// Same result as m_residue_2_2N_array, by mod_pow2_array. Even moduli, as
+// used by some RTL residue tests, take the slow path.
+void m_residue_2_2N_fast_array(uint32_t length, uint32_t N, uint32_t *M,
+		uint32_t *temp, uint32_t *Nr) {
+	if ((M[length - 1] & 1) == 0) {
+		m_residue_2_2N_array(length, N, M, temp, Nr);
+		return;
+	}
+	mod_pow2_array(length, M, 2 * N, temp, Nr);
+}
+
+// Bit length of E, from its most significant non zero word.
 uint32_t findN(uint32_t length, uint32_t *E) {
-	uint32_t n = 0;
-	for (uint32_t i = 0; i < 32 * length; i++) {
+	const uint32_t used = significant_length_array(length, E);
+	uint32_t n = 32 * (used - 1);
+	for (uint32_t top = E[length - used]; top != 0; top >>= 1)
+		n++;
+	return n;
+}
+
+// Words the kernels need for X, E and M of length words: the longest of
+// the three without its leading zero words. Test vectors and the RTL
+// layout pad operands, e.g. 5 words for a 128 bit modulus, and every
+// padded word costs a share of each product. The variable time entry
+// points run at this length and pad Z back; the secret modes of a
+// mont_ctx do not look at the values, so they keep the caller's length.
+static uint32_t mont_trim_length(uint32_t length, uint32_t *X, uint32_t *E,
+		uint32_t *M) {
+	uint32_t trim = significant_length_array(length, M);
+	const uint32_t x = significant_length_array(length, X);
+	const uint32_t e = significant_length_array(length, E);
+	if (x > trim)
+		trim = x;
+	if (e > trim)
+		trim = e;
+	return trim;
+}
+
+// Steps 3. - 9. of mont_exp_array, with Z holding Z0 = R mod M on entry.
+// Z, P and temp2 (length words) take turns as Zi, Pi and the free buffer:
+// every product goes to the free one, which saves copying it back.
+void mont_exp_loop_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
+		uint32_t n0, uint32_t *Nr, uint32_t *P, uint32_t *ONE, uint32_t *temp2,
+		uint32_t *Z) {
+	uint32_t *z = Z;
+	uint32_t *p = P;
+	uint32_t *spare = temp2;
+	uint32_t *t;
+
+	// 3. P0 := MontProd( X, Nr, M );
+	mont_prod_cios_array(length, X, Nr, M, n0, p);
+	//debugArray("P0", length, p);
+
+	// 4. for i = 0 to n-1 loop
+	const uint32_t n = findN(length, E); //loop optimization for low values of E. Not necessary.
+	for (uint32_t i = 0; i < n; i++) {
 		uint32_t ei_ = E[length - 1 - (i / 32)];
 		uint32_t ei = (ei_ >> (i % 32)) & 1;
+		// 6. if (ei = 1) then Zi+1 := MontProd ( Zi, Pi, M) else Zi+1 := Zi
 		if (ei == 1) {
-			n = i+1;
+			mont_prod_cios_array(length, z, p, M, n0, spare);
+			t = z; z = spare; spare = t;
+			//debugArray("Z ", length, z);
 		}
+		// 5. Pi+1 := MontProd( Pi, Pi, M );
+		mont_prod_cios_array(length, p, p, M, n0, spare);
+		t = p; p = spare; spare = t;
+		//debugArray("P ", length, p);
+		// 7. end for
 	}
-	return n;
+	// 8. Zn := MontProd( 1, Zn, M );
+	if (z == Z) {
+		mont_prod_cios_array(length, ONE, z, M, n0, spare);
+		copy_array(length, spare, Z);
+	} else {
+		mont_prod_cios_array(length, ONE, z, M, n0, Z);
+	}
+	//debugArray("Z ", length, Z);
+	// 9. RETURN Zn
+
 }
 
 void mont_exp_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
@@ -64,42 +327,292 @@ void mont_exp_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
 
 	// 1. Nr := 2 ** 2N mod M
 	const uint32_t N = 32 * length;
-	m_residue_2_2N_array(length, N, M, temp, Nr);
+	const uint32_t n0 = mont_n0_array(length, M);
+	m_residue_2_2N_fast_array(length, N, M, temp, Nr);
 	//debugArray("Nr", length, Nr);
 
 	// 2. Z0 := MontProd( 1, Nr, M )
 	zero_array(length, ONE);
 	ONE[length - 1] = 1;
-	mont_prod_array(length, ONE, Nr, M, Z);
+	mont_prod_cios_array(length, ONE, Nr, M, n0, Z);
 	//debugArray("Z0", length, Z);
 
-	// 3. P0 := MontProd( X, Nr, M );
-	mont_prod_array(length, X, Nr, M, P);
-	//debugArray("P0", length, P);
+	// 3. - 9.
+	mont_exp_loop_array(length, X, E, M, n0, Nr, P, ONE, temp2, Z);
+}
 
-	// 4. for i = 0 to n-1 loop
-	const uint32_t n = findN(length, E); //loop optimization for low values of E. Not necessary.
-	for (uint32_t i = 0; i < n; i++) {
-		uint32_t ei_ = E[length - 1 - (i / 32)];
-		uint32_t ei = (ei_ >> (i % 32)) & 1;
-		// 6. if (ei = 1) then Zi+1 := MontProd ( Zi, Pi, M) else Zi+1 := Zi
-		if (ei == 1) {
-			mont_prod_array(length, Z, P, M, temp2);
-			copy_array(length, temp2, Z);
-			//debugArray("Z ", length, Z);
+// Exponent bit i, counting from the least significant bit.
+uint32_t exp_bit_array(uint32_t length, uint32_t *E, uint32_t i) {
+	return (E[length - 1 - (i / 32)] >> (i % 32)) & 1;
+}
+
+// Window width for an n bit exponent. Going from w to w + 1 bits doubles
+// the 2^(w-1) table entries but saves n/(w+1) - n/(w+2) multiplications,
+// which pays off once n > 2^(w-1) * (w+1) * (w+2).
+uint32_t mont_window_bits(uint32_t n) {
+	uint32_t w = 1;
+	while ((w < MONT_WINDOW_MAX) && (n > (1u << (w - 1)) * (w + 1) * (w + 2)))
+		w++;
+	return w;
+}
+
+// Window width for the exponent E. Short and sparse exponents such as 3 or
+// 65537, with fewer set bits than a window table would save, use 1, i.e.
+// a plain square and multiply chain.
+uint32_t mont_window_bits_exp(uint32_t length, uint32_t *E) {
+	const uint32_t n = findN(length, E);
+	const uint32_t w = mont_window_bits(n);
+	uint32_t weight = 0;
+	for (uint32_t i = 0; i < n; i++)
+		weight += exp_bit_array(length, E, i);
+	if (weight * (w + 1) <= n)
+		return 1;
+	return w;
+}
+
+// Left to right sliding window exponentiation. Same contract as
+// mont_exp_loop_array: Z holds R mod M on entry and X ** E mod M on exit.
+// table holds the 2^(window-1) odd powers X^1, X^3, ... in the Montgomery
+// domain, length words each. window == 0 selects mont_window_bits_exp.
+// The running product moves between Z and P, temp2 holds 2*length words
+// for mont_sqr_array.
+void mont_exp_window_loop_array(uint32_t length, uint32_t *X, uint32_t *E,
+		uint32_t *M, uint32_t n0, uint32_t *Nr, uint32_t window,
+		uint32_t *table, uint32_t *P, uint32_t *temp2, uint32_t *Z) {
+	const uint32_t n = findN(length, E);
+	if (window == 0)
+		window = mont_window_bits_exp(length, E);
+
+	// table[k] := MontProd( X, Nr, M ) ** (2k + 1)
+	mont_prod_cios_array(length, X, Nr, M, n0, table);
+	if (window > 1) {
+		mont_prod_cios_array(length, table, table, M, n0, temp2);
+		for (uint32_t k = 1; k < (1u << (window - 1)); k++)
+			mont_prod_cios_array(length, table + (k - 1) * length, temp2, M, n0,
+					table + k * length);
+	}
+
+	uint32_t *z = Z;
+	uint32_t started = 0; // Z is still one, squarings can be skipped.
+	int32_t i = ((int32_t) n) - 1;
+	while (i >= 0) {
+		if (exp_bit_array(length, E, (uint32_t) i) == 0) {
+			if (started)
+				mont_sqr_array(length, z, M, n0, temp2, z);
+			i--;
+			continue;
 		}
-		// 5. Pi+1 := MontProd( Pi, Pi, M );
-		mont_prod_array(length, P, P, M, temp2);
-		copy_array(length, temp2, P);
-		//debugArray("P ", length, P);
-		// 7. end for
+
+		// Longest window E[i .. j] of at most window bits ending in a one.
+		int32_t j = i - ((int32_t) window) + 1;
+		if (j < 0)
+			j = 0;
+		while (exp_bit_array(length, E, (uint32_t) j) == 0)
+			j++;
+		uint32_t value = 0;
+		for (int32_t k = i; k >= j; k--)
+			value = (value << 1) | exp_bit_array(length, E, (uint32_t) k);
+
+		uint32_t *entry = table + (value >> 1) * length;
+		if (started) {
+			for (int32_t k = i; k >= j; k--)
+				mont_sqr_array(length, z, M, n0, temp2, z);
+			uint32_t *next = (z == Z) ? P : Z;
+			mont_prod_cios_array(length, z, entry, M, n0, next);
+			z = next;
+		} else {
+			copy_array(length, entry, z);
+			started = 1;
+		}
+		i = j - 1;
 	}
-	// 8. Zn := MontProd( 1, Zn, M );
-	mont_prod_array(length, ONE, Z, M, temp2);
-	copy_array(length, temp2, Z);
-	//debugArray("Z ", length, Z);
-	// 9. RETURN Zn
 
+	mont_redc_array(length, M, n0, z);
+	if (z != Z)
+		copy_array(length, z, Z);
+}
+
+// The width bits of E starting at bit lo, bits above the exponent read as 0.
+uint32_t exp_bits_array(uint32_t length, uint32_t *E, int32_t lo, uint32_t width) {
+	uint32_t value = 0;
+	for (int32_t k = lo + ((int32_t) width) - 1; k >= lo; k--) {
+		value <<= 1;
+		if (k < 32 * (int32_t) length)
+			value |= exp_bit_array(length, E, (uint32_t) k);
+	}
+	return value;
+}
+
+// dst := table[index], reading every entry so that the memory access
+// pattern does not depend on index.
+void mont_table_select_array(uint32_t length, uint32_t *table,
+		uint32_t entries, uint32_t index, uint32_t *dst) {
+	zero_array(length, dst);
+	for (uint32_t k = 0; k < entries; k++) {
+		uint32_t mask = (uint32_t) (((uint64_t) (k ^ index) - 1) >> 32);
+		for (uint32_t j = 0; j < length; j++)
+			dst[j] |= table[k * length + j] & mask;
+	}
+}
+
+// Width of the fixed window for an nbits exponent: window, or one picked
+// from nbits if it is 0, limited so that all 2^window powers fit the table.
+uint32_t mont_fixed_window_bits(uint32_t nbits, uint32_t window) {
+	if (window == 0)
+		window = mont_window_bits(nbits);
+	if (window > MONT_WINDOW_MAX - 1)
+		window = MONT_WINDOW_MAX - 1;
+	return window;
+}
+
+// Fixed window exponentiation for secret exponents. Every one of the
+// 32*length exponent bits costs one squaring and every window one
+// multiplication by a masked table lookup, also for zero windows, so the
+// sequence of operations is independent of the exponent value.
+// Same contract as mont_exp_loop_array. table holds 2^window entries and
+// window == 0 picks a width from the exponent length. temp2 holds 2*length
+// words.
+void mont_exp_fixed_window_loop_array(uint32_t length, uint32_t *X, uint32_t *E,
+		uint32_t *M, uint32_t n0, uint32_t *Nr, uint32_t window,
+		uint32_t *table, uint32_t *P, uint32_t *temp2, uint32_t *Z) {
+	const int32_t nbits = 32 * (int32_t) length;
+	window = mont_fixed_window_bits((uint32_t) nbits, window);
+	const uint32_t entries = 1u << window;
+
+	// table[k] := MontProd( X, Nr, M ) ** k
+	copy_array(length, Z, table);
+	mont_prod_cios_array(length, X, Nr, M, n0, table + length);
+	for (uint32_t k = 2; k < entries; k++)
+		mont_prod_cios_array(length, table + (k - 1) * length, table + length, M,
+				n0, table + k * length);
+
+	int32_t i = nbits - (int32_t) window;
+	if (nbits % (int32_t) window)
+		i = nbits - nbits % (int32_t) window;
+	mont_table_select_array(length, table, entries,
+			exp_bits_array(length, E, i, window), Z);
+	// The running product moves between Z and P, the window's entry goes to
+	// temp2, which is free between the squarings.
+	uint32_t *z = Z;
+	while (i > 0) {
+		i -= (int32_t) window;
+		for (uint32_t k = 0; k < window; k++)
+			mont_sqr_array(length, z, M, n0, temp2, z);
+		mont_table_select_array(length, table, entries,
+				exp_bits_array(length, E, i, window), temp2 + length);
+		uint32_t *next = (z == Z) ? P : Z;
+		mont_prod_cios_array(length, z, temp2 + length, M, n0, next);
+		z = next;
+	}
+
+	mont_redc_array(length, M, n0, z);
+	if (z != Z)
+		copy_array(length, z, Z);
+}
+
+// Next sliding window of E at or below bit i, as taken by
+// mont_exp_window_loop_array: the longest run E[hi .. *lo] of at most
+// window bits from the highest set bit hi <= i that ends in a one. Returns
+// its value, or 0 with *lo = -1 if no bit at or below i is set.
+uint32_t exp_window_array(uint32_t length, uint32_t *E, int32_t i,
+		uint32_t window, int32_t *lo) {
+	while ((i >= 0) && (exp_bit_array(length, E, (uint32_t) i) == 0))
+		i--;
+	if (i < 0) {
+		*lo = -1;
+		return 0;
+	}
+	int32_t j = i - ((int32_t) window) + 1;
+	if (j < 0)
+		j = 0;
+	while (exp_bit_array(length, E, (uint32_t) j) == 0)
+		j++;
+	*lo = j;
+	return exp_bits_array(length, E, j, (uint32_t) (i - j + 1));
+}
+
+// Interleaved sliding window (Straus) exponentiation for public exponents:
+// X[0] ** E[0] * ... * X[count - 1] ** E[count - 1] mod M with a single
+// chain of squarings. Every base has its own table of odd powers and
+// window width, and is multiplied in wherever one of its windows ends, so
+// two bases cost the squarings of one exponentiation plus the
+// multiplications of both. Same contract as mont_exp_loop_array. count is
+// 1 to MONT_MULTI_MAX, table holds count tables of 2^(MONT_WINDOW_MAX-1)
+// entries, P length words and temp2 2*length words, as in
+// mont_exp_window_loop_array.
+void mont_exp_multi_loop_array(uint32_t length, uint32_t count, uint32_t **X,
+		uint32_t **E, uint32_t *M, uint32_t n0, uint32_t *Nr, uint32_t *table,
+		uint32_t *P, uint32_t *temp2, uint32_t *Z) {
+	if ((count == 0) || (count > MONT_MULTI_MAX)) die("count");
+	const uint32_t stride = length << (MONT_WINDOW_MAX - 1);
+	uint32_t window[MONT_MULTI_MAX];
+	uint32_t value[MONT_MULTI_MAX];
+	int32_t lo[MONT_MULTI_MAX];
+	int32_t top = -1;
+	for (uint32_t b = 0; b < count; b++) {
+		uint32_t *t = table + b * stride;
+		const int32_t n = (int32_t) findN(length, E[b]);
+		window[b] = mont_window_bits_exp(length, E[b]);
+
+		// t[k] := MontProd( X[b], Nr, M ) ** (2k + 1)
+		mont_prod_cios_array(length, X[b], Nr, M, n0, t);
+		if (window[b] > 1) {
+			mont_prod_cios_array(length, t, t, M, n0, temp2);
+			for (uint32_t k = 1; k < (1u << (window[b] - 1)); k++)
+				mont_prod_cios_array(length, t + (k - 1) * length, temp2, M, n0,
+						t + k * length);
+		}
+		value[b] = exp_window_array(length, E[b], n - 1, window[b], &lo[b]);
+		if (n - 1 > top)
+			top = n - 1;
+	}
+
+	uint32_t *z = Z;
+	uint32_t started = 0; // Z is still one, squarings can be skipped.
+	for (int32_t i = top; i >= 0; i--) {
+		if (started)
+			mont_sqr_array(length, z, M, n0, temp2, z);
+		for (uint32_t b = 0; b < count; b++) {
+			if (lo[b] != i)
+				continue;
+			uint32_t *entry = table + b * stride + (value[b] >> 1) * length;
+			if (started) {
+				uint32_t *next = (z == Z) ? P : Z;
+				mont_prod_cios_array(length, z, entry, M, n0, next);
+				z = next;
+			} else {
+				copy_array(length, entry, z);
+				started = 1;
+			}
+			value[b] = exp_window_array(length, E[b], i - 1, window[b], &lo[b]);
+		}
+	}
+
+	mont_redc_array(length, M, n0, z);
+	if (z != Z)
+		copy_array(length, z, Z);
+}
+
+// Montgomery ladder for secret exponents: Z and P hold X^k and X^(k+1)
+// and every exponent bit costs one multiplication and one squaring, with
+// the bit only selecting, through masked swaps, which of the two is squared.
+// Same contract as mont_exp_loop_array. The products go to spare, length
+// words, which then takes turns with P; temp2 holds 2*length words.
+void mont_exp_ladder_loop_array(uint32_t length, uint32_t *X, uint32_t *E,
+		uint32_t *M, uint32_t n0, uint32_t *Nr, uint32_t *P, uint32_t *spare,
+		uint32_t *temp2, uint32_t *Z) {
+	uint32_t *t;
+	mont_prod_cios_array(length, X, Nr, M, n0, P);
+	for (int32_t i = 32 * ((int32_t) length) - 1; i >= 0; i--) {
+		uint32_t mask = 0 - exp_bit_array(length, E, (uint32_t) i);
+		cswap_array(length, mask, Z, P);
+		mont_prod_cios_array(length, Z, P, M, n0, spare);
+		t = P; P = spare; spare = t;
+		mont_sqr_array(length, Z, M, n0, temp2, Z);
+		cswap_array(length, mask, Z, P);
+	}
+
+	mont_redc_array(length, M, n0, Z);
 }
 
 // Experimental version where we add explicit lengths.
@@ -112,38 +625,50 @@ void mont_exp_array2(uint32_t explength, uint32_t modlength, uint32_t *X, uint32
 
 	// 1. Nr := 2 ** 2N mod M
 	const uint32_t N = 32 * modlength;
-	m_residue_2_2N_array(modlength, N, M, temp, Nr);
+	const uint32_t n0 = mont_n0_array(modlength, M);
+	m_residue_2_2N_fast_array(modlength, N, M, temp, Nr);
 	//debugArray("Nr", length, Nr);
 
 	// 2. Z0 := MontProd( 1, Nr, M )
 	zero_array(modlength, ONE);
 	ONE[modlength - 1] = 1;
-	mont_prod_array(modlength, ONE, Nr, M, Z);
+	mont_prod_cios_array(modlength, ONE, Nr, M, n0, Z);
 	//debugArray("Z0", length, Z);
 
 	// 3. P0 := MontProd( X, Nr, M );
-	mont_prod_array(modlength, X, Nr, M, P);
-	//debugArray("P0", length, P);
+	// Z, P and temp2 rotate as in mont_exp_loop_array.
+	uint32_t *z = Z;
+	uint32_t *p = P;
+	uint32_t *spare = temp2;
+	uint32_t *t;
+	mont_prod_cios_array(modlength, X, Nr, M, n0, p);
+	//debugArray("P0", length, p);
 
-	// 4. for i = 0 to explength - 1 loop
-	for (uint32_t i = 0; i < (explength * 32); i++) {
+	// 4. for i = 0 to findN - 1 loop, the leading zero bits of E only
+	// square P.
+	const uint32_t n = findN(explength, E);
+	for (uint32_t i = 0; i < n; i++) {
 		uint32_t ei_ = E[explength - 1 - (i / 32)];
 		uint32_t ei = (ei_ >> (i % 32)) & 1;
 		// 6. if (ei = 1) then Zi+1 := MontProd ( Zi, Pi, M) else Zi+1 := Zi
 		if (ei == 1) {
-			mont_prod_array(modlength, Z, P, M, temp2);
-			copy_array(modlength, temp2, Z);
-			//debugArray("Z ", length, Z);
+			mont_prod_cios_array(modlength, z, p, M, n0, spare);
+			t = z; z = spare; spare = t;
+			//debugArray("Z ", length, z);
 		}
 		// 5. Pi+1 := MontProd( Pi, Pi, M );
-		mont_prod_array(modlength, P, P, M, temp2);
-		copy_array(modlength, temp2, P);
-		//debugArray("P ", length, P);
+		mont_prod_cios_array(modlength, p, p, M, n0, spare);
+		t = p; p = spare; spare = t;
+		//debugArray("P ", length, p);
 		// 7. end for
 	}
 	// 8. Zn := MontProd( 1, Zn, M );
-	mont_prod_array(modlength, ONE, Z, M, temp2);
-	copy_array(modlength, temp2, Z);
+	if (z == Z) {
+		mont_prod_cios_array(modlength, ONE, z, M, n0, spare);
+		copy_array(modlength, spare, Z);
+	} else {
+		mont_prod_cios_array(modlength, ONE, z, M, n0, Z);
+	}
 	//debugArray("Z ", length, Z);
 	// 9. RETURN Zn
 
@@ -154,41 +679,427 @@ void die(const char *c) {
 	exit(1);
 }
 
-void mod_exp_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M, uint32_t *Z) {
-	uint32_t *Nr = calloc(length, sizeof(uint32_t));
+// Z := X ** E mod M for exponents that mont_window_bits_exp maps to a plain
+// square and multiply chain, e.g. the public exponents 3 and 65537. Instead
+// of computing Nr = R^2 mod M, X is brought into the Montgomery domain by a
+// single division of X * R by M and taken out again by one REDC.
+void mod_exp_public_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
+		uint32_t *Z) {
+	uint32_t *XR = calloc(2 * length, sizeof(uint32_t));
+	uint32_t *temp = calloc(2 * length, sizeof(uint32_t));
 	uint32_t *P = calloc(length, sizeof(uint32_t));
-	uint32_t *ONE = calloc(length, sizeof(uint32_t));
-	uint32_t *temp = calloc(length, sizeof(uint32_t));
-	uint32_t *temp2 = calloc(length, sizeof(uint32_t));
-	if (Nr == NULL) die("calloc");
-	if (P == NULL) die("calloc");
-	if (ONE == NULL) die("calloc");
+	if (XR == NULL) die("calloc");
 	if (temp == NULL) die("calloc");
-	if (temp2 == NULL) die("calloc");
-	mont_exp_array(length, X, E, M, Nr, P, ONE, temp, temp2, Z);
-	free(Nr);
-	free(P);
-	free(ONE);
+	if (P == NULL) die("calloc");
+
+	const uint32_t n = findN(length, E);
+	const uint32_t n0 = mont_n0_array(length, M);
+	if (n == 0) {
+		// X ** 0 == 1 mod M
+		XR[2 * length - 1] = 1;
+		divmod_array(2 * length, XR, length, M, NULL, Z, temp);
+	} else {
+		// P := X * R mod M
+		copy_array(length, X, XR);
+		divmod_array(2 * length, XR, length, M, NULL, P, temp);
+
+		// The power moves between Z and XR, which is free from here on.
+		uint32_t *z = Z;
+		copy_array(length, P, z);
+		for (int32_t i = ((int32_t) n) - 2; i >= 0; i--) {
+			mont_sqr_array(length, z, M, n0, temp, z);
+			if (exp_bit_array(length, E, (uint32_t) i)) {
+				uint32_t *next = (z == Z) ? XR : Z;
+				mont_prod_cios_array(length, z, P, M, n0, next);
+				z = next;
+			}
+		}
+		mont_redc_array(length, M, n0, z);
+		if (z != Z)
+			copy_array(length, z, Z);
+	}
+
+	free(XR);
 	free(temp);
-	free(temp2);
+	free(P);
+}
+
+// Variable time, as it has always been. Use a mont_ctx in one of the
+// secret modes for private exponents.
+void mod_exp_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M, uint32_t *Z) {
+	const uint32_t trim = mont_trim_length(length, X, E, M);
+	if (trim < length) {
+		const uint32_t pad = length - trim;
+		mod_exp_array(trim, X + pad, E + pad, M + pad, Z + pad);
+		zero_array(pad, Z);
+		return;
+	}
+	if (mont_window_bits_exp(length, E) == 1) {
+		mont_get_dispatch()->mod_exp_public(length, X, E, M, Z);
+		return;
+	}
+	mont_ctx *ctx = mont_ctx_new(length, M);
+	ctx->mode = MONT_EXP_MODE_PUBLIC_FAST;
+	mod_exp_ctx(ctx, X, E, Z);
+	mont_ctx_free(ctx);
+}
+
+// Bytes of workspace mont_ctx_init needs for a length word modulus: the
+// 64 bit limb state where it is compiled in, then the uint32_t buffers.
+size_t mont_ctx_workspace_size(uint32_t length) {
+	size_t size = 0;
+#ifdef MONT_HAVE_UINT64
+	size += sizeof(mont_ctx_u64) + mont_ctx_u64_words(length) * sizeof(uint64_t);
+#endif
+	return size + (8 * (size_t) length + ((size_t) length << (MONT_WINDOW_MAX - 1)))
+			* sizeof(uint32_t);
+}
+
+// Sets up ctx for M with all its buffers in workspace, at least
+// mont_ctx_workspace_size(length) bytes aligned for uint64_t, without
+// allocating. ctx and workspace must outlive every use of ctx; there is
+// nothing to free. The IFMA backend is left to mont_ctx_new, as it keeps
+// its own aligned allocations.
+void mont_ctx_init(mont_ctx *ctx, uint32_t length, uint32_t *M, void *workspace) {
+	uint8_t *next = workspace;
+	uint32_t *buf;
+#ifdef MONT_HAVE_UINT64
+	mont_ctx_u64 *u64 = (mont_ctx_u64 *) next;
+	uint64_t *buf64 = (uint64_t *) (u64 + 1);
+	next = (uint8_t *) (buf64 + mont_ctx_u64_words(length));
+#endif
+	buf = (uint32_t *) next;
+	ctx->length = length;
+	ctx->M = buf;
+	ctx->Nr = ctx->M + length;
+	ctx->Rm = ctx->Nr + length;
+	ctx->ONE = ctx->Rm + length;
+	ctx->P = ctx->ONE + length;
+	ctx->temp = ctx->P + length;
+	ctx->temp2 = ctx->temp + length;
+	ctx->table = ctx->temp2 + 2 * length;
+	ctx->u64 = NULL;
+	ctx->ifma = NULL;
+	ctx->window = 0;
+
+	copy_array(length, M, ctx->M);
+	ctx->mode = MONT_EXP_MODE_SECRET_SECURE;
+	ctx->backend = MONT_BACKEND_UINT32;
+#ifdef MONT_HAVE_UINT64
+	if (mont_get_dispatch()->features & MONT_CPU_UINT64) {
+		ctx->backend = MONT_BACKEND_UINT64;
+		ctx->u64 = u64;
+		mont_ctx_u64_init(u64, length, M, buf64, ctx->temp2);
+	}
+#endif
+	ctx->n0 = mont_n0_array(length, M);
+	m_residue_2_2N_fast_array(length, 32 * length, M, ctx->temp, ctx->Nr);
+	zero_array(length, ctx->ONE);
+	ctx->ONE[length - 1] = 1;
+	mont_prod_cios_array(length, ctx->ONE, ctx->Nr, M, ctx->n0, ctx->Rm);
+}
+
+// mont_ctx_init in a single allocation, plus the IFMA state where the CPU
+// has it.
+mont_ctx *mont_ctx_new(uint32_t length, uint32_t *M) {
+	mont_ctx *ctx = calloc(1, sizeof(mont_ctx) + mont_ctx_workspace_size(length));
+	if (ctx == NULL) die("calloc");
+	mont_ctx_init(ctx, length, M, ctx + 1);
+#ifdef MONT_HAVE_IFMA
+	if (mont_get_dispatch()->features & MONT_CPU_IFMA)
+		ctx->ifma = mont_ctx_ifma_new(length, M);
+	if (ctx->ifma != NULL)
+		ctx->backend = MONT_BACKEND_IFMA;
+#endif
+	return ctx;
+}
+
+void mont_ctx_free(mont_ctx *ctx) {
+	if (ctx == NULL)
+		return;
+#ifdef MONT_HAVE_IFMA
+	mont_ctx_ifma_free(ctx->ifma);
+#endif
+	free(ctx);
+}
+
+// Z := X ** E mod M like mod_exp_array, with every buffer in workspace,
+// mont_ctx_workspace_size(length) bytes, so that nothing is allocated. A
+// workspace sized for the longest modulus can be kept per thread and
+// reused for every call.
+void mod_exp_ws_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
+		uint32_t *Z, void *workspace) {
+	const uint32_t trim = mont_trim_length(length, X, E, M);
+	const uint32_t pad = length - trim;
+	mont_ctx ctx;
+	mont_ctx_init(&ctx, trim, M + pad, workspace);
+	ctx.mode = MONT_EXP_MODE_PUBLIC_FAST;
+	mod_exp_ctx(&ctx, X + pad, E + pad, Z + pad);
+	zero_array(pad, Z);
+}
+
+// Z := X ** E mod ctx->M, E has the same length as the modulus.
+void mod_exp_ctx(mont_ctx *ctx, uint32_t *X, uint32_t *E, uint32_t *Z) {
+#ifdef MONT_HAVE_IFMA
+	if (ctx->backend == MONT_BACKEND_IFMA) {
+		mod_exp_ifma_ctx(ctx->ifma, ctx->mode, ctx->window, X, E, Z);
+		return;
+	}
+#endif
+#ifdef MONT_HAVE_UINT64
+	if (ctx->backend == MONT_BACKEND_UINT64) {
+		mod_exp_u64_ctx(ctx->u64, ctx->mode, ctx->window, ctx->length, X, E, Z);
+		return;
+	}
+#endif
+	copy_array(ctx->length, ctx->Rm, Z);
+	switch (ctx->mode) {
+	case MONT_EXP_MODE_PUBLIC_FAST:
+		mont_exp_window_loop_array(ctx->length, X, E, ctx->M, ctx->n0, ctx->Nr,
+				ctx->window, ctx->table, ctx->P, ctx->temp2, Z);
+		break;
+	case MONT_EXP_MODE_SECRET_LADDER:
+		mont_exp_ladder_loop_array(ctx->length, X, E, ctx->M, ctx->n0, ctx->Nr,
+				ctx->P, ctx->table, ctx->temp2, Z);
+		break;
+	default:
+		mont_exp_fixed_window_loop_array(ctx->length, X, E, ctx->M, ctx->n0,
+				ctx->Nr, ctx->window, ctx->table, ctx->P, ctx->temp2, Z);
+		break;
+	}
+}
+
+// mod_exp_ctx for X, E and Z as little endian arrays of
+// U64_LENGTH(ctx->length) uint64_t limbs (bignum_uint64_t.h) holding
+// values of at most 32*ctx->length bits, e.g. byte strings from the wire
+// on a little endian host. The 64 bit limb backend
+// reads and writes them in place; the others, and the IFMA backend, go
+// through one conversion to and from the big endian layout.
+void mod_exp_le_ctx(mont_ctx *ctx, uint64_t *X, uint64_t *E, uint64_t *Z) {
+	const uint32_t length = ctx->length;
+	const uint32_t n = U64_LENGTH(length);
+#ifdef MONT_HAVE_UINT64
+	if (ctx->backend == MONT_BACKEND_UINT64) {
+		mod_exp_u64_le_ctx(ctx->u64, ctx->mode, ctx->window, X, E, Z);
+		return;
+	}
+#endif
+	uint32_t *buf = calloc(3 * (size_t) length, sizeof(uint32_t));
+	if (buf == NULL) die("calloc");
+	u64_to_array(n, X, length, buf);
+	u64_to_array(n, E, length, buf + length);
+	mod_exp_ctx(ctx, buf, buf + length, buf + 2 * length);
+	array_to_u64(length, buf + 2 * length, n, Z);
+	free(buf);
+}
+
+// Montgomery domain operations, for chains of modular products that
+// convert their inputs once with to_mont_ctx and their result once with
+// from_mont_ctx. Values in the domain hold x * R mod M, less than M, as
+// length word arrays. R depends on the backend, 2^(32*length) for
+// MONT_BACKEND_UINT32 and 2^(64*U64_LENGTH(length)) otherwise, so they are
+// only meaningful to the ctx, and the backend, they were made with. The
+// outputs may overlap the inputs.
+
+#ifdef MONT_HAVE_UINT64
+// The 64 bit limb state the domain operations use, NULL for uint32_t.
+static mont_ctx_u64 *mont_domain_u64(mont_ctx *ctx) {
+	return (ctx->backend != MONT_BACKEND_UINT32) ? ctx->u64 : NULL;
+}
+#endif
+
+// A := X * R mod M for X < M.
+void to_mont_ctx(mont_ctx *ctx, uint32_t *X, uint32_t *A) {
+#ifdef MONT_HAVE_UINT64
+	if (mont_domain_u64(ctx) != NULL) {
+		to_mont_domain_u64(ctx->u64, ctx->length, X, A);
+		return;
+	}
+#endif
+	mont_prod_cios_array(ctx->length, X, ctx->Nr, ctx->M, ctx->n0, ctx->temp2);
+	copy_array(ctx->length, ctx->temp2, A);
+}
+
+// Z := A / R mod M, by a REDC instead of a product with one.
+void from_mont_ctx(mont_ctx *ctx, uint32_t *A, uint32_t *Z) {
+#ifdef MONT_HAVE_UINT64
+	if (mont_domain_u64(ctx) != NULL) {
+		from_mont_domain_u64(ctx->u64, ctx->length, A, Z);
+		return;
+	}
+#endif
+	if (Z != A)
+		copy_array(ctx->length, A, Z);
+	mont_redc_array(ctx->length, ctx->M, ctx->n0, Z);
+}
+
+// Z := A * B / R mod M, the product of the two values in the domain.
+void mont_mul_ctx(mont_ctx *ctx, uint32_t *A, uint32_t *B, uint32_t *Z) {
+#ifdef MONT_HAVE_UINT64
+	if (mont_domain_u64(ctx) != NULL) {
+		mont_mul_domain_u64(ctx->u64, ctx->length, A, B, Z);
+		return;
+	}
+#endif
+	mont_prod_cios_array(ctx->length, A, B, ctx->M, ctx->n0, ctx->temp2);
+	copy_array(ctx->length, ctx->temp2, Z);
+}
+
+// Z := A * A / R mod M.
+void mont_sqr_ctx(mont_ctx *ctx, uint32_t *A, uint32_t *Z) {
+#ifdef MONT_HAVE_UINT64
+	if (mont_domain_u64(ctx) != NULL) {
+		mont_sqr_domain_u64(ctx->u64, ctx->length, A, Z);
+		return;
+	}
+#endif
+	mont_sqr_array(ctx->length, A, ctx->M, ctx->n0, ctx->temp2, Z);
+}
+
+// Z := A ** E with A and Z in the domain, in ctx->mode and ctx->window as
+// mod_exp_ctx. The uint32_t loops take A in with MontProd( A, Rm ), which
+// leaves it as it is, but end with a REDC that one product with Nr
+// undoes: two products more than the 64 bit limb path.
+void mont_exp_in_domain_ctx(mont_ctx *ctx, uint32_t *A, uint32_t *E,
+		uint32_t *Z) {
+	const uint32_t length = ctx->length;
+#ifdef MONT_HAVE_UINT64
+	if (mont_domain_u64(ctx) != NULL) {
+		mont_exp_domain_u64(ctx->u64, ctx->mode, ctx->window, length, A, E, Z);
+		return;
+	}
+#endif
+	uint32_t *X = ctx->temp;
+	copy_array(length, A, X);
+	copy_array(length, ctx->Rm, Z);
+	switch (ctx->mode) {
+	case MONT_EXP_MODE_PUBLIC_FAST:
+		mont_exp_window_loop_array(length, X, E, ctx->M, ctx->n0, ctx->Rm,
+				ctx->window, ctx->table, ctx->P, ctx->temp2, Z);
+		break;
+	case MONT_EXP_MODE_SECRET_LADDER:
+		mont_exp_ladder_loop_array(length, X, E, ctx->M, ctx->n0, ctx->Rm,
+				ctx->P, ctx->table, ctx->temp2, Z);
+		break;
+	default:
+		mont_exp_fixed_window_loop_array(length, X, E, ctx->M, ctx->n0,
+				ctx->Rm, ctx->window, ctx->table, ctx->P, ctx->temp2, Z);
+		break;
+	}
+	to_mont_ctx(ctx, Z, Z);
+}
+
+// Z := A ** (2^T) with A and Z in the domain, T squarings in a row. The
+// 64 bit limb backend keeps the values below 2M in between where 4M < R,
+// see mont_sqr_chain_u64; the uint32_t one reduces every square.
+void mont_sqr_chain_ctx(mont_ctx *ctx, uint32_t *A, uint64_t T, uint32_t *Z) {
+#ifdef MONT_HAVE_UINT64
+	if (mont_domain_u64(ctx) != NULL) {
+		mont_sqr_chain_domain_u64(ctx->u64, ctx->length, A, T, Z);
+		return;
+	}
+#endif
+	if (Z != A)
+		copy_array(ctx->length, A, Z);
+	for (uint64_t k = 0; k < T; k++)
+		mont_sqr_array(ctx->length, Z, ctx->M, ctx->n0, ctx->temp2, Z);
+}
+
+// X := X ** (2^(T - done)) mod M, for sequential squaring workloads such
+// as time-lock puzzles, with X = x ** (2^done) mod M on entry. Every
+// interval squarings, counted from x, and unless interval is 0,
+// checkpoint is called with the count so far and x ** (2^count) mod M, a
+// plain value independent of the backend that a later call can resume
+// from. A non zero return stops the run there. Returns the count reached.
+uint64_t mod_sqr_chain_ctx(mont_ctx *ctx, uint32_t *X, uint64_t T,
+		uint64_t done, uint64_t interval,
+		int (*checkpoint)(void *arg, uint64_t done, uint32_t *X), void *arg) {
+	to_mont_ctx(ctx, X, X);
+	while (done < T) {
+		uint64_t steps = T - done;
+		if ((interval != 0) && (steps > interval - done % interval))
+			steps = interval - done % interval;
+		mont_sqr_chain_ctx(ctx, X, steps, X);
+		done += steps;
+		if ((checkpoint != NULL) && (interval != 0) && (done % interval == 0)) {
+			from_mont_ctx(ctx, X, ctx->temp);
+			if (checkpoint(arg, done, ctx->temp))
+				break;
+		}
+	}
+	from_mont_ctx(ctx, X, X);
+	return done;
+}
+
+// Z := X[0] ** E[0] * ... * X[count - 1] ** E[count - 1] mod ctx->M, with
+// 1 to MONT_MULTI_MAX bases of ctx->length words and exponents of the
+// same length. Runs in variable time like MONT_EXP_MODE_PUBLIC_FAST,
+// whatever ctx->mode, for signature verification and similar public
+// exponents. Z must not overlap X.
+void mod_exp_multi_ctx(mont_ctx *ctx, uint32_t count, uint32_t **X,
+		uint32_t **E, uint32_t *Z) {
+	if ((count == 0) || (count > MONT_MULTI_MAX)) die("count");
+#ifdef MONT_HAVE_UINT64
+	if ((ctx->backend != MONT_BACKEND_UINT32) && (ctx->u64 != NULL)) {
+		mod_exp_multi_u64_ctx(ctx->u64, ctx->length, count, X, E, Z);
+		return;
+	}
+#endif
+	uint32_t *table = calloc((size_t) count * ctx->length << (MONT_WINDOW_MAX - 1),
+			sizeof(uint32_t));
+	if (table == NULL) die("calloc");
+	copy_array(ctx->length, ctx->Rm, Z);
+	mont_exp_multi_loop_array(ctx->length, count, X, E, ctx->M, ctx->n0, ctx->Nr,
+			table, ctx->P, ctx->temp2, Z);
+	free(table);
+}
+
+// mod_exp_multi_ctx at the length of mont_trim_length over all operands.
+void mod_exp_multi_array(uint32_t length, uint32_t count, uint32_t **X,
+		uint32_t **E, uint32_t *M, uint32_t *Z) {
+	uint32_t *Xt[MONT_MULTI_MAX];
+	uint32_t *Et[MONT_MULTI_MAX];
+	if ((count == 0) || (count > MONT_MULTI_MAX)) die("count");
+	uint32_t trim = 1;
+	for (uint32_t b = 0; b < count; b++) {
+		const uint32_t t = mont_trim_length(length, X[b], E[b], M);
+		if (t > trim)
+			trim = t;
+	}
+	const uint32_t pad = length - trim;
+	for (uint32_t b = 0; b < count; b++) {
+		Xt[b] = X[b] + pad;
+		Et[b] = E[b] + pad;
+	}
+	mont_ctx *ctx = mont_ctx_new(trim, M + pad);
+	mod_exp_multi_ctx(ctx, count, Xt, Et, Z + pad);
+	mont_ctx_free(ctx);
+	zero_array(pad, Z);
 }
 
 // Experimental version with explicit explength separate from modlength.
+// Runs at the lengths without leading zero words, see mont_trim_length.
 void mod_exp_array2(uint32_t explength, uint32_t modlength, uint32_t *X, uint32_t *E, uint32_t *M, uint32_t *Z) {
-	uint32_t *Nr = calloc(modlength, sizeof(uint32_t));
-	uint32_t *P = calloc(modlength, sizeof(uint32_t));
-	uint32_t *ONE = calloc(modlength, sizeof(uint32_t));
-	uint32_t *temp = calloc(modlength, sizeof(uint32_t));
-	uint32_t *temp2 = calloc(modlength, sizeof(uint32_t));
-	if (Nr == NULL) die("calloc");
-	if (P == NULL) die("calloc");
-	if (ONE == NULL) die("calloc");
-	if (temp == NULL) die("calloc");
-	if (temp2 == NULL) die("calloc");
-	mont_exp_array2(explength, modlength, X, E, M, Nr, P, ONE, temp, temp2, Z);
-	free(Nr);
-	free(P);
-	free(ONE);
-	free(temp);
-	free(temp2);
+	const uint32_t elength = significant_length_array(explength, E);
+	uint32_t mlength = significant_length_array(modlength, M);
+	const uint32_t xlength = significant_length_array(modlength, X);
+	if (xlength > mlength)
+		mlength = xlength;
+	const uint32_t pad = modlength - mlength;
+	E += explength - elength;
+	X += pad;
+	M += pad;
+	explength = elength;
+	modlength = mlength;
+	uint32_t *buf = calloc(5 * (size_t) modlength, sizeof(uint32_t));
+	if (buf == NULL) die("calloc");
+	uint32_t *Nr = buf;
+	uint32_t *P = Nr + modlength;
+	uint32_t *ONE = P + modlength;
+	uint32_t *temp = ONE + modlength;
+	uint32_t *temp2 = temp + modlength;
+	mont_exp_array2(explength, modlength, X, E, M, Nr, P, ONE, temp, temp2,
+			Z + pad);
+	free(buf);
+	zero_array(pad, Z);
 }
@@ -10,8 +10,116 @@
 
 void mont_prod_array(uint32_t length, uint32_t *A, uint32_t *B, uint32_t *M,
 		uint32_t *s);
+uint32_t mont_n0_array(uint32_t length, uint32_t *M);
+void mont_prod_cios_array(uint32_t length, uint32_t *A, uint32_t *B, uint32_t *M,
+		uint32_t n0, uint32_t *s);
+void m_residue_2_2N_array(uint32_t length, uint32_t N, uint32_t *M, uint32_t *temp,
+		uint32_t *Nr);
+void m_residue_2_2N_fast_array(uint32_t length, uint32_t N, uint32_t *M,
+		uint32_t *temp, uint32_t *Nr);
+void mod_pow2_array(uint32_t length, uint32_t *M, uint32_t e, uint32_t *temp,
+		uint32_t *r);
+void mont_redc_array(uint32_t length, uint32_t *M, uint32_t n0, uint32_t *s);
+void mont_redc_wide_array(uint32_t length, uint32_t *M, uint32_t n0, uint32_t *t,
+		uint32_t *s);
+void mont_sqr_array(uint32_t length, uint32_t *A, uint32_t *M, uint32_t n0,
+		uint32_t *t, uint32_t *s);
 void mod_exp_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M, uint32_t *Z);
+void mod_exp_public_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
+		uint32_t *Z);
+
+#define MONT_WINDOW_MAX 7
+
+// Bases per mod_exp_multi_ctx call.
+#define MONT_MULTI_MAX 8
+
+// Exponentiation modes, numbered as EXPONATION_MODE_* in modexp_core.v.
+// The secret modes run in time independent of the exponent value.
+#define MONT_EXP_MODE_SECRET_SECURE 0
+#define MONT_EXP_MODE_PUBLIC_FAST   1
+#define MONT_EXP_MODE_SECRET_LADDER 2
+
+// Limb size used by mod_exp_ctx. MONT_BACKEND_UINT64 (montgomery_uint64_t.h)
+// is the default where the compiler supports it, MONT_BACKEND_IFMA
+// (montgomery_ifma.h) where the CPU has AVX-512 IFMA.
+#define MONT_BACKEND_UINT32 0
+#define MONT_BACKEND_UINT64 1
+#define MONT_BACKEND_IFMA   2
+
+void die(const char *c);
+uint32_t findN(uint32_t length, uint32_t *E);
+uint32_t exp_bit_array(uint32_t length, uint32_t *E, uint32_t i);
+uint32_t exp_bits_array(uint32_t length, uint32_t *E, int32_t lo, uint32_t width);
+void mont_table_select_array(uint32_t length, uint32_t *table,
+		uint32_t entries, uint32_t index, uint32_t *dst);
+uint32_t exp_window_array(uint32_t length, uint32_t *E, int32_t i,
+		uint32_t window, int32_t *lo);
+
+uint32_t mont_window_bits(uint32_t n);
+uint32_t mont_window_bits_exp(uint32_t length, uint32_t *E);
+uint32_t mont_fixed_window_bits(uint32_t nbits, uint32_t window);
+void mont_exp_window_loop_array(uint32_t length, uint32_t *X, uint32_t *E,
+		uint32_t *M, uint32_t n0, uint32_t *Nr, uint32_t window,
+		uint32_t *table, uint32_t *P, uint32_t *temp2, uint32_t *Z);
+void mont_exp_fixed_window_loop_array(uint32_t length, uint32_t *X, uint32_t *E,
+		uint32_t *M, uint32_t n0, uint32_t *Nr, uint32_t window,
+		uint32_t *table, uint32_t *P, uint32_t *temp2, uint32_t *Z);
+void mont_exp_ladder_loop_array(uint32_t length, uint32_t *X, uint32_t *E,
+		uint32_t *M, uint32_t n0, uint32_t *Nr, uint32_t *P, uint32_t *spare,
+		uint32_t *temp2, uint32_t *Z);
+void mont_exp_multi_loop_array(uint32_t length, uint32_t count, uint32_t **X,
+		uint32_t **E, uint32_t *M, uint32_t n0, uint32_t *Nr, uint32_t *table,
+		uint32_t *P, uint32_t *temp2, uint32_t *Z);
+
+// Per modulus state for repeated exponentiations: the modulus, n0',
+// Nr = R^2 mod M, Rm = R mod M and scratch buffers, all of ctx->length
+// words except temp2, which holds 2*length words. The scratch buffers
+// make a context usable by one thread at a time.
+// mode is one of MONT_EXP_MODE_*, MONT_EXP_MODE_SECRET_SECURE by default.
+// window is the window width, 1 to MONT_WINDOW_MAX, or 0 to pick it from
+// the exponent length. table holds the window's precomputed powers.
+// backend is one of MONT_BACKEND_*, u64 and ifma the state for
+// MONT_BACKEND_UINT64 and MONT_BACKEND_IFMA, NULL where unavailable.
+typedef struct {
+	uint32_t length;
+	uint32_t n0;
+	uint32_t mode;
+	uint32_t window;
+	uint32_t backend;
+	uint32_t *M;
+	uint32_t *Nr;
+	uint32_t *Rm;
+	uint32_t *ONE;
+	uint32_t *P;
+	uint32_t *temp;
+	uint32_t *temp2;
+	uint32_t *table;
+	struct mont_ctx_u64 *u64;
+	struct mont_ctx_ifma *ifma;
+} mont_ctx;
 
+size_t mont_ctx_workspace_size(uint32_t length);
+void mont_ctx_init(mont_ctx *ctx, uint32_t length, uint32_t *M, void *workspace);
+mont_ctx *mont_ctx_new(uint32_t length, uint32_t *M);
+void mont_ctx_free(mont_ctx *ctx);
+void mod_exp_ctx(mont_ctx *ctx, uint32_t *X, uint32_t *E, uint32_t *Z);
+void to_mont_ctx(mont_ctx *ctx, uint32_t *X, uint32_t *A);
+void from_mont_ctx(mont_ctx *ctx, uint32_t *A, uint32_t *Z);
+void mont_mul_ctx(mont_ctx *ctx, uint32_t *A, uint32_t *B, uint32_t *Z);
+void mont_sqr_ctx(mont_ctx *ctx, uint32_t *A, uint32_t *Z);
+void mont_exp_in_domain_ctx(mont_ctx *ctx, uint32_t *A, uint32_t *E,
+		uint32_t *Z);
+void mont_sqr_chain_ctx(mont_ctx *ctx, uint32_t *A, uint64_t T, uint32_t *Z);
+uint64_t mod_sqr_chain_ctx(mont_ctx *ctx, uint32_t *X, uint64_t T,
+		uint64_t done, uint64_t interval,
+		int (*checkpoint)(void *arg, uint64_t done, uint32_t *X), void *arg);
+void mod_exp_le_ctx(mont_ctx *ctx, uint64_t *X, uint64_t *E, uint64_t *Z);
+void mod_exp_ws_array(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
+		uint32_t *Z, void *workspace);
+void mod_exp_multi_ctx(mont_ctx *ctx, uint32_t count, uint32_t **X,
+		uint32_t **E, uint32_t *Z);
+void mod_exp_multi_array(uint32_t length, uint32_t count, uint32_t **X,
+		uint32_t **E, uint32_t *M, uint32_t *Z);
 
 void mont_prod_array2(uint32_t explength, uint32_t modlength, uint32_t *A, uint32_t *B, uint32_t *M,
 		uint32_t *s);
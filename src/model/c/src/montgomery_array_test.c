@@ -2,6 +2,14 @@
 #include <stdlib.h>
 #include "montgomery_array.h"
 #include "bignum_uint32_t.h"
+#include "montgomery_uint64_t.h"
+#include "montgomery_batch.h"
+#include "montgomery_ifma.h"
+#include "montgomery_adx.h"
+#include "montgomery_dispatch.h"
+#include "montgomery_crt.h"
+#include "montgomery_comb.h"
+#include "montgomery_pool.h"
 
 const uint32_t TEST_CONSTANT_PRIME_15_1 = 65537;
 const uint32_t TEST_CONSTANT_PRIME_31_1 = 2147483647u; // eighth Mersenne prime
@@ -99,6 +107,53 @@ void test_montgomery_modulus() {
 	assertArrayEquals(3, expected2, actual2);
 }
 
+void test_mont_prod_cios() {
+	printf("=== test_mont_prod_cios ===\n");
+	uint32_t A[] = { 0, (1 << (61 - 32)) - 1, 0xffffffff }; //2^61-1
+	uint32_t B[] = { 0x00000001, 0x2345abcd, 0x89abcdef };
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t expected[3];
+	uint32_t actual[3];
+
+	uint32_t n0 = mont_n0_array(3, M);
+	uint32_t minus_one[] = { 0xffffffff };
+	uint32_t m0_n0[] = { M[2] * n0 };
+	assertArrayEquals(1, minus_one, m0_n0);
+
+	// The bit serial reference leaves its result in [0, 2M).
+	mont_prod_array(3, A, B, M, expected);
+	if (!greater_than_array(3, M, expected))
+		sub_array(3, expected, M, expected);
+	mont_prod_cios_array(3, A, B, M, n0, actual);
+	assertArrayEquals(3, expected, actual);
+
+	mont_prod_array(3, B, B, M, expected);
+	if (!greater_than_array(3, M, expected))
+		sub_array(3, expected, M, expected);
+	mont_prod_cios_array(3, B, B, M, n0, actual);
+	assertArrayEquals(3, expected, actual);
+}
+
+void test_divmod() {
+	printf("=== test_divmod ===\n");
+	uint32_t A[] = { 0x0153db9b, 0x314b8066, 0x3462631f, 0x89abcdef };
+	uint32_t B[] = { 0x00000001, 0xffffffff, 0x80000001 };
+	uint32_t temp[4];
+	uint32_t q[4];
+	uint32_t r[3];
+	divmod_array(4, A, 3, B, q, r, temp);
+	uint32_t expected_q[] = { 0x00000000, 0x00000000, 0x00a9edcd, 0x98d03ba6 };
+	uint32_t expected_r[] = { 0x00000001, 0x00209324, 0xf0db9249 };
+	assertArrayEquals(4, expected_q, q);
+	assertArrayEquals(3, expected_r, r);
+
+	// Single word divisor.
+	uint32_t M[] = { 0, 0, (1u << 31) - 1 };
+	divmod_array(4, A, 3, M, q, r, temp);
+	uint32_t expected_r2[] = { 0, 0, 0x423d72a0 };
+	assertArrayEquals(3, expected_r2, r);
+}
+
 /*
  @Test
  public void test_huge_numbers() {
@@ -168,6 +223,998 @@ void test_montgomery_modexp() {
 	assertArrayEquals(3, expected, Z);
 }
 
+void test_mont_sqr() {
+	printf("=== test_mont_sqr ===\n");
+	uint32_t A[] = { 0x00000001, 0x2345abcd, 0x89abcdef };
+	uint32_t B[] = { 0x01ffffff, 0xffffffff, 0xfffffffe };
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t n0 = mont_n0_array(3, M);
+	uint32_t t[6];
+	uint32_t expected[3];
+	uint32_t actual[3];
+
+	mont_prod_cios_array(3, A, A, M, n0, expected);
+	mont_sqr_array(3, A, M, n0, t, actual);
+	assertArrayEquals(3, expected, actual);
+
+	// In place, with a value close to M.
+	mont_prod_cios_array(3, B, B, M, n0, expected);
+	mont_sqr_array(3, B, M, n0, t, B);
+	assertArrayEquals(3, expected, B);
+}
+
+#if defined(MONT_HAVE_UINT64) || defined(MONT_HAVE_IFMA)
+// Random operands of one size for the product kernel tests, also in 64 bit
+// limbs where the uint64_t backend is built. M is odd with the top bit set,
+// A and B are below M.
+typedef struct {
+	uint32_t length;
+	uint32_t n0;
+	uint32_t *A, *B, *M, *expected, *actual;
+#ifdef MONT_HAVE_UINT64
+	uint32_t length64;
+	uint64_t n064;
+	uint64_t *A64, *B64, *M64, *s64, *t64;
+#endif
+} test_prod_operands;
+
+static void test_prod_operands_init(test_prod_operands *t, uint32_t bits,
+		uint32_t seed) {
+	t->length = bits / 32;
+	t->A = calloc(5 * t->length, sizeof(uint32_t));
+	if (t->A == NULL) die("calloc");
+	t->B = t->A + t->length;
+	t->M = t->B + t->length;
+	t->expected = t->M + t->length;
+	t->actual = t->expected + t->length;
+	uint32_t x = seed;
+	for (uint32_t i = 0; i < t->length; i++) {
+		x = x * 1664525 + 1013904223;
+		t->M[i] = x;
+		t->A[i] = x >> 1;
+		t->B[i] = x >> 2 ^ i;
+	}
+	t->M[0] |= 0x80000000;
+	t->M[t->length - 1] |= 1;
+	t->n0 = mont_n0_array(t->length, t->M);
+#ifdef MONT_HAVE_UINT64
+	t->length64 = U64_LENGTH(t->length);
+	t->A64 = calloc(6 * t->length64, sizeof(uint64_t));
+	if (t->A64 == NULL) die("calloc");
+	t->B64 = t->A64 + t->length64;
+	t->M64 = t->B64 + t->length64;
+	t->s64 = t->M64 + t->length64;
+	t->t64 = t->s64 + t->length64;
+	array_to_u64(t->length, t->A, t->length64, t->A64);
+	array_to_u64(t->length, t->B, t->length64, t->B64);
+	array_to_u64(t->length, t->M, t->length64, t->M64);
+	t->n064 = mont_n0_u64(t->length64, t->M64);
+#endif
+}
+
+static void test_prod_operands_free(test_prod_operands *t) {
+	free(t->A);
+#ifdef MONT_HAVE_UINT64
+	free(t->A64);
+#endif
+}
+#endif
+
+#ifdef MONT_HAVE_UINT64
+// Products at the fixed kernel sizes against mont_prod_cios_array. With
+// an even number of words R is the same for both backends.
+void test_mont_prod_u64_fixed() {
+	printf("=== test_mont_prod_u64_fixed ===\n");
+	const uint32_t sizes[] = { 1024, 2048, 3072, 4096, 8192 };
+	for (uint32_t k = 0; k < 5; k++) {
+		test_prod_operands t;
+		test_prod_operands_init(&t, sizes[k], 0x12345678);
+
+		mont_prod_cios_array(t.length, t.A, t.B, t.M, t.n0, t.expected);
+		mont_prod_u64(t.length64, t.A64, t.B64, t.M64, t.n064, t.s64);
+		u64_to_array(t.length64, t.s64, t.length, t.actual);
+		assertArrayEquals(t.length, t.expected, t.actual);
+
+		mont_prod_cios_array(t.length, t.A, t.A, t.M, t.n0, t.expected);
+		mont_sqr_u64(t.length64, t.A64, t.M64, t.n064, t.t64, t.s64);
+		u64_to_array(t.length64, t.s64, t.length, t.actual);
+		assertArrayEquals(t.length, t.expected, t.actual);
+
+		test_prod_operands_free(&t);
+	}
+}
+#endif
+
+#if defined(MONT_HAVE_UINT64) && defined(MONT_HAVE_ADX)
+void test_mont_prod_adx() {
+	printf("=== test_mont_prod_adx ===\n");
+	if (!mont_adx_available()) {
+		printf("skipped, no BMI2/ADX\n");
+		return;
+	}
+	const uint32_t sizes[] = { 64, 1024, 1088, 2048, 4096, 8192 };
+	for (uint32_t k = 0; k < 6; k++) {
+		test_prod_operands t;
+		test_prod_operands_init(&t, sizes[k], 0x2545f491);
+
+		mont_prod_cios_array(t.length, t.A, t.B, t.M, t.n0, t.expected);
+		mont_prod_adx(t.length64, t.A64, t.B64, t.M64, t.n064, t.s64);
+		u64_to_array(t.length64, t.s64, t.length, t.actual);
+		assertArrayEquals(t.length, t.expected, t.actual);
+
+		// In place, as the exponentiation loops use it.
+		mont_prod_cios_array(t.length, t.A, t.A, t.M, t.n0, t.expected);
+		mont_prod_adx(t.length64, t.A64, t.A64, t.M64, t.n064, t.A64);
+		u64_to_array(t.length64, t.A64, t.length, t.actual);
+		assertArrayEquals(t.length, t.expected, t.actual);
+
+		test_prod_operands_free(&t);
+	}
+}
+#endif
+
+#ifdef MONT_HAVE_UINT64
+void test_mont_prod_karatsuba() {
+	printf("=== test_mont_prod_karatsuba ===\n");
+	// Around the MUL_KARATSUBA_LIMBS split, odd limb counts included.
+	const uint32_t sizes[] = { 64, 2048, 2112, 4160, 8192, 8256 };
+	for (uint32_t k = 0; k < 6; k++) {
+		test_prod_operands t;
+		test_prod_operands_init(&t, sizes[k], 0x6c8e9cf5);
+		uint64_t *w64 = calloc(mul_karatsuba_u64_scratch(t.length64) + 1,
+				sizeof(uint64_t));
+		if (w64 == NULL) die("calloc");
+
+		mont_prod_cios_array(t.length, t.A, t.B, t.M, t.n0, t.expected);
+		mont_prod_karatsuba_u64(t.length64, t.A64, t.B64, t.M64, t.n064,
+				t.t64, w64, t.s64);
+		u64_to_array(t.length64, t.s64, t.length, t.actual);
+		assertArrayEquals(t.length, t.expected, t.actual);
+
+		mont_prod_cios_array(t.length, t.A, t.A, t.M, t.n0, t.expected);
+		mont_sqr_karatsuba_u64(t.length64, t.A64, t.M64, t.n064, t.t64, w64,
+				t.A64);
+		u64_to_array(t.length64, t.A64, t.length, t.actual);
+		assertArrayEquals(t.length, t.expected, t.actual);
+
+		free(w64);
+		test_prod_operands_free(&t);
+	}
+}
+#endif
+
+#ifdef MONT_HAVE_IFMA
+void test_mont_prod_ifma() {
+	printf("=== test_mont_prod_ifma ===\n");
+	if (!mont_ifma_available()) {
+		printf("skipped, no AVX-512 IFMA\n");
+		return;
+	}
+	// 33 words has a leading zero word like the test vectors below.
+	const uint32_t sizes[] = { 96, 1024, 1056, 2048, 3072, 4096, 8192 };
+	for (uint32_t k = 0; k < 7; k++) {
+		test_prod_operands t;
+		test_prod_operands_init(&t, sizes[k], 0x9e3779b9);
+		// mont_prod_array needs two spare bits above M.
+		t.M[0] = (t.M[0] >> 2) | 0x10000000;
+		if (sizes[k] == 1056)
+			t.M[0] = 0;
+		t.A[0] = t.M[0] >> 1;
+		t.B[0] = t.M[0] >> 2;
+		mont_ctx_ifma *ctx = mont_ctx_ifma_new(t.length, t.M);
+
+		// The bit serial reference leaves its result in [0, 2M).
+		mont_prod_array(t.length, t.A, t.B, t.M, t.expected);
+		if (!greater_than_array(t.length, t.M, t.expected))
+			sub_array(t.length, t.expected, t.M, t.expected);
+		mont_prod_ifma_array(ctx, t.A, t.B, t.actual);
+		assertArrayEquals(t.length, t.expected, t.actual);
+
+		mont_prod_array(t.length, t.A, t.A, t.M, t.expected);
+		if (!greater_than_array(t.length, t.M, t.expected))
+			sub_array(t.length, t.expected, t.M, t.expected);
+		mont_prod_ifma_array(ctx, t.A, t.A, t.actual);
+		assertArrayEquals(t.length, t.expected, t.actual);
+
+		mont_ctx_ifma_free(ctx);
+		test_prod_operands_free(&t);
+	}
+}
+#endif
+
+void test_m_residue_fast() {
+	printf("=== test_m_residue_fast ===\n");
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t M2[] = { 0, 0x0153db9b, 0x314b8067 };
+	uint32_t M3[] = { 0x80000000, 0x00000000, 0x00000001 };
+	uint32_t Meven[] = { 0, 0, 0x8 };
+	uint32_t temp[3];
+	uint32_t expected[3];
+	uint32_t actual[3];
+
+	// From tb_residue.v
+	uint32_t expected_96[] = { 0, 0, 0x4000 };
+	m_residue_2_2N_fast_array(3, 96, M, temp, actual);
+	assertArrayEquals(3, expected_96, actual);
+
+	m_residue_2_2N_array(3, 77, M, temp, expected);
+	m_residue_2_2N_fast_array(3, 77, M, temp, actual);
+	assertArrayEquals(3, expected, actual);
+
+	m_residue_2_2N_array(3, 96, M2, temp, expected);
+	m_residue_2_2N_fast_array(3, 96, M2, temp, actual);
+	assertArrayEquals(3, expected, actual);
+
+	// M3 = 2^95 + 1 uses the top bit, which m_residue_2_2N_array shifts out.
+	// 2^192 = (2^95)^2 * 4 == 4 mod M3.
+	uint32_t expected_M3[] = { 0, 0, 4 };
+	m_residue_2_2N_fast_array(3, 96, M3, temp, actual);
+	assertArrayEquals(3, expected_M3, actual);
+
+	m_residue_2_2N_array(3, 16, Meven, temp, expected);
+	m_residue_2_2N_fast_array(3, 16, Meven, temp, actual);
+	assertArrayEquals(3, expected, actual);
+}
+
+void test_mod_exp_ctx() {
+	printf("=== test_mod_exp_ctx ===\n");
+	uint32_t X[] = { 0, (1 << (61 - 32)) - 1, 0xffffffff }; //2^61-1 Ivan Mikheevich Pervushin
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1 R. E. Powers
+	uint32_t E[] = { 0, 0, 0x7fffffff }; //Leonhard Euler
+
+	uint32_t ONE[] = { 0, 0, 1 };
+	uint32_t Z[] = { 0, 0, 0 };
+
+	mont_ctx *ctx = mont_ctx_new(3, M);
+
+	mod_exp_ctx(ctx, X, E, Z);
+	uint32_t expected[] = { 0x0153db9b, 0x314b8066, 0x3462631f };
+	assertArrayEquals(3, expected, Z);
+
+	mod_exp_ctx(ctx, ONE, E, Z);
+	assertArrayEquals(3, ONE, Z);
+
+	mod_exp_ctx(ctx, X, E, Z);
+	assertArrayEquals(3, expected, Z);
+
+	mont_ctx_free(ctx);
+}
+
+void test_mod_exp_window() {
+	printf("=== test_mod_exp_window ===\n");
+	uint32_t X[] = { 0, (1 << (61 - 32)) - 1, 0xffffffff }; //2^61-1
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t E[] = { 0x01234567, 0x89abcdef, 0x7fffffff };
+	uint32_t expected[] = { 0x018cc964, 0x11be03e2, 0x9973f1dd };
+	uint32_t Z[3];
+
+	mont_ctx *ctx = mont_ctx_new(3, M);
+	ctx->mode = MONT_EXP_MODE_PUBLIC_FAST;
+	for (uint32_t w = 0; w <= MONT_WINDOW_MAX; w++) {
+		ctx->window = w;
+		mod_exp_ctx(ctx, X, E, Z);
+		assertArrayEquals(3, expected, Z);
+	}
+	mont_ctx_free(ctx);
+}
+
+void test_mod_exp_secret() {
+	printf("=== test_mod_exp_secret ===\n");
+	uint32_t X[] = { 0, (1 << (61 - 32)) - 1, 0xffffffff }; //2^61-1
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t E[] = { 0x01234567, 0x89abcdef, 0x7fffffff };
+	uint32_t expected[] = { 0x018cc964, 0x11be03e2, 0x9973f1dd };
+	uint32_t ZERO[] = { 0, 0, 0 };
+	uint32_t ONE[] = { 0, 0, 1 };
+	uint32_t Z[3];
+
+	mont_ctx *ctx = mont_ctx_new(3, M);
+	for (uint32_t w = 0; w < MONT_WINDOW_MAX; w++) {
+		ctx->window = w;
+		mod_exp_ctx(ctx, X, E, Z);
+		assertArrayEquals(3, expected, Z);
+	}
+	mod_exp_ctx(ctx, X, ZERO, Z);
+	assertArrayEquals(3, ONE, Z);
+
+	ctx->mode = MONT_EXP_MODE_SECRET_LADDER;
+	mod_exp_ctx(ctx, X, E, Z);
+	assertArrayEquals(3, expected, Z);
+	mod_exp_ctx(ctx, X, ZERO, Z);
+	assertArrayEquals(3, ONE, Z);
+	mont_ctx_free(ctx);
+}
+
+void test_mod_exp_public() {
+	printf("=== test_mod_exp_public ===\n");
+	uint32_t X[] = { 0, (1 << (61 - 32)) - 1, 0xffffffff }; //2^61-1
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t E3[] = { 0, 0, 3 };
+	uint32_t E65537[] = { 0, 0, 0x00010001 };
+	uint32_t ZERO[] = { 0, 0, 0 };
+	uint32_t ONE[] = { 0, 0, 1 };
+	uint32_t expected3[] = { 0x00000000, 0x5ffffffa, 0x0000001f };
+	uint32_t expected65537[] = { 0x0016574d, 0x2ed94a50, 0x2161feb1 };
+	uint32_t Z[3];
+
+	mod_exp_public_array(3, X, E3, M, Z);
+	assertArrayEquals(3, expected3, Z);
+	mod_exp_public_array(3, X, E65537, M, Z);
+	assertArrayEquals(3, expected65537, Z);
+	mod_exp_public_array(3, X, ZERO, M, Z);
+	assertArrayEquals(3, ONE, Z);
+}
+
+void test_mod_exp_multi() {
+	printf("=== test_mod_exp_multi ===\n");
+	uint32_t Xs[MONT_MULTI_MAX][32], Es[MONT_MULTI_MAX][32], M[32], Z[32], T[32],
+			expected[32];
+	uint32_t *X[MONT_MULTI_MAX], *E[MONT_MULTI_MAX];
+	const uint32_t counts[] = { 1, 2, 3, MONT_MULTI_MAX };
+	uint32_t x = 0x0badcafe;
+	for (uint32_t b = 0; b < MONT_MULTI_MAX; b++) {
+		X[b] = Xs[b];
+		E[b] = Es[b];
+	}
+	for (uint32_t i = 0; i < 32; i++) {
+		for (uint32_t b = 0; b < MONT_MULTI_MAX; b++) {
+			x = x * 1664525 + 1013904223;
+			Xs[b][i] = x >> 1;
+			// Past the third base, 64 bit exponents.
+			Es[b][i] = ((b == 0) || ((b > 2) && (i >= 30))) ? x : 0;
+		}
+		M[i] = x | 0x80000000;
+	}
+	M[31] |= 1;
+	Es[1][31] = 0x00010001; // short and sparse, a window width of 1
+	Es[2][27] = 0x00c0ffee; // a 152 bit exponent
+
+	// expected := product of the single exponentiations
+	mont_ctx *ctx = mont_ctx_new(32, M);
+	const uint32_t backend0 = ctx->backend;
+	for (uint32_t c = 0; c < 4; c++) {
+		const uint32_t count = counts[c];
+		copy_array(32, ctx->Rm, expected);
+		for (uint32_t b = 0; b < count; b++) {
+			mod_exp_ctx(ctx, X[b], E[b], Z);
+			mont_prod_cios_array(32, Z, ctx->Nr, M, ctx->n0, T);
+			mont_prod_cios_array(32, expected, T, M, ctx->n0, Z);
+			copy_array(32, Z, expected);
+		}
+		mont_redc_array(32, M, ctx->n0, expected);
+
+		for (uint32_t backend = MONT_BACKEND_UINT32;
+				backend <= MONT_BACKEND_UINT64; backend++) {
+			if ((backend == MONT_BACKEND_UINT64) && (ctx->u64 == NULL))
+				continue;
+			ctx->backend = backend;
+			mod_exp_multi_ctx(ctx, count, X, E, Z);
+			assertArrayEquals(32, expected, Z);
+		}
+		ctx->backend = backend0;
+	}
+
+	// All exponents zero.
+	uint32_t ONE[32] = { 0 };
+	ONE[31] = 1;
+	zero_array(32, Es[0]);
+	zero_array(32, Es[1]);
+	zero_array(32, Es[2]);
+	mod_exp_multi_array(32, 3, X, E, M, Z);
+	assertArrayEquals(32, ONE, Z);
+	mont_ctx_free(ctx);
+}
+
+void test_mod_exp_comb() {
+	printf("=== test_mod_exp_comb ===\n");
+	uint32_t G[33], M[33], E[33], Z[33], expected[33];
+	const uint32_t shapes[][2] = { { 0, 0 }, { 1, 1 }, { 4, 3 }, { 5, 7 },
+			{ 10, 1 } };
+	const char *backends[] = { "uint32", NULL };
+	uint32_t x = 0x5eed0c0b;
+	for (uint32_t i = 0; i < 33; i++) {
+		x = x * 1664525 + 1013904223;
+		G[i] = x >> 1;
+		M[i] = x | 0x80000000;
+	}
+	M[32] |= 1;
+
+	for (uint32_t length = 32; length <= 33; length++) {
+		mont_ctx *ctx = mont_ctx_new(length, M);
+		for (uint32_t b = 0; b < 2; b++) {
+			mont_dispatch_init(backends[b]);
+			for (uint32_t k = 0; k < 5; k++) {
+				mont_comb *comb = mont_comb_new(length, G, M, shapes[k][0],
+						shapes[k][1]);
+				for (uint32_t e = 0; e < 3; e++) {
+					for (uint32_t i = 0; i < length; i++) {
+						x = x * 1664525 + 1013904223;
+						E[i] = (e == 0) ? x : (e == 1) ? 0 : 0xffffffff;
+					}
+					mod_exp_ctx(ctx, G, E, expected);
+					mod_exp_comb(comb, E, Z);
+					assertArrayEquals(length, expected, Z);
+				}
+				mont_comb_free(comb);
+			}
+		}
+		mont_ctx_free(ctx);
+	}
+	mont_dispatch_init(getenv("MONT_BACKEND"));
+}
+
+static void test_mod_exp_pool_done(mont_job *job) {
+	*(uint32_t *) job->arg += 1;
+}
+
+void test_mod_exp_pool() {
+	printf("=== test_mod_exp_pool ===\n");
+	// Two moduli of 16 and 32 words, 24 jobs alternating between them.
+	uint32_t M[2][32], X[24][32], E[24][32], Z[24][32], expected[32];
+	uint32_t calls[24] = { 0 };
+	uint32_t ones[24], lengths[] = { 16, 32 };
+	mont_job jobs[24];
+	uint32_t x = 0x7001c0de;
+	for (uint32_t i = 0; i < 32; i++) {
+		for (uint32_t m = 0; m < 2; m++) {
+			x = x * 1664525 + 1013904223;
+			M[m][i] = x | 0x80000000;
+		}
+		for (uint32_t k = 0; k < 24; k++) {
+			x = x * 1664525 + 1013904223;
+			X[k][i] = x >> 1;
+			E[k][i] = x;
+		}
+	}
+	M[0][15] |= 1;
+	M[1][31] |= 1;
+	for (uint32_t k = 0; k < 24; k++) {
+		jobs[k].length = lengths[k % 2];
+		jobs[k].mode = (k % 3 == 0) ? MONT_EXP_MODE_PUBLIC_FAST
+				: MONT_EXP_MODE_SECRET_SECURE;
+		jobs[k].X = X[k];
+		jobs[k].E = E[k];
+		jobs[k].M = M[k % 2];
+		jobs[k].Z = Z[k];
+		jobs[k].done = test_mod_exp_pool_done;
+		jobs[k].arg = &calls[k];
+		ones[k] = 1;
+	}
+
+	mont_pool *pool = mont_pool_new(4);
+	mod_exp_pool(pool, 16, jobs);
+	mont_pool_submit(pool, 8, jobs + 16);
+	mont_pool_wait(pool);
+	uint32_t completed[] = { (uint32_t) mont_pool_completed(pool) };
+	uint32_t expected_completed[] = { 24 };
+	mont_pool_free(pool);
+
+	assertArrayEquals(1, expected_completed, completed);
+	assertArrayEquals(24, ones, calls);
+	for (uint32_t k = 0; k < 24; k++) {
+		mod_exp_array(lengths[k % 2], X[k], E[k], M[k % 2], expected);
+		assertArrayEquals(lengths[k % 2], expected, Z[k]);
+	}
+}
+
+void test_mod_exp_ws() {
+	printf("=== test_mod_exp_ws ===\n");
+	// One workspace for the longest modulus, reused for shorter ones, in
+	// every mode and backend, against the plain square and multiply chain.
+	uint32_t X[33], M[33], E[33], Z[33], expected[33];
+	const uint32_t lengths[] = { 33, 7, 32, 1 };
+	const uint32_t modes[] = { MONT_EXP_MODE_PUBLIC_FAST,
+			MONT_EXP_MODE_SECRET_SECURE, MONT_EXP_MODE_SECRET_LADDER };
+	const char *backends[] = { "uint32", NULL };
+	void *workspace = calloc(1, mont_ctx_workspace_size(33));
+	if (workspace == NULL) die("calloc");
+	uint32_t x = 0x3a7e5eed;
+	for (uint32_t b = 0; b < 2; b++) {
+		mont_dispatch_init(backends[b]);
+		for (uint32_t l = 0; l < 4; l++) {
+			const uint32_t length = lengths[l];
+			for (uint32_t i = 0; i < length; i++) {
+				x = x * 1664525 + 1013904223;
+				X[i] = x >> 1;
+				M[i] = x | 0x80000000;
+				x = x * 1664525 + 1013904223;
+				E[i] = x;
+			}
+			M[length - 1] |= 1;
+			mod_exp_array2(length, length, X, E, M, expected);
+
+			mod_exp_ws_array(length, X, E, M, Z, workspace);
+			assertArrayEquals(length, expected, Z);
+			mont_ctx ctx;
+			mont_ctx_init(&ctx, length, M, workspace);
+			for (uint32_t m = 0; m < 3; m++) {
+				ctx.mode = modes[m];
+				mod_exp_ctx(&ctx, X, E, Z);
+				assertArrayEquals(length, expected, Z);
+			}
+		}
+	}
+	free(workspace);
+	mont_dispatch_init(getenv("MONT_BACKEND"));
+}
+
+void test_mod_exp_le() {
+	printf("=== test_mod_exp_le ===\n");
+	// Little endian limbs in and out, against mod_exp_ctx on the big
+	// endian words, in every mode and backend.
+	uint32_t X[33], M[33], E[33], Z[33], expected[33];
+	uint64_t X64[17], E64[17], Z64[17];
+	const uint32_t lengths[] = { 33, 32, 7 };
+	const uint32_t modes[] = { MONT_EXP_MODE_PUBLIC_FAST,
+			MONT_EXP_MODE_SECRET_SECURE, MONT_EXP_MODE_SECRET_LADDER };
+	const char *backends[] = { "uint32", NULL };
+	uint32_t x = 0x1e1e5eed;
+	for (uint32_t b = 0; b < 2; b++) {
+		mont_dispatch_init(backends[b]);
+		for (uint32_t l = 0; l < 3; l++) {
+			const uint32_t length = lengths[l];
+			const uint32_t length64 = U64_LENGTH(length);
+			for (uint32_t i = 0; i < length; i++) {
+				x = x * 1664525 + 1013904223;
+				X[i] = x >> 1;
+				M[i] = x | 0x80000000;
+				x = x * 1664525 + 1013904223;
+				E[i] = x;
+			}
+			M[length - 1] |= 1;
+			array_to_u64(length, X, length64, X64);
+			array_to_u64(length, E, length64, E64);
+			mont_ctx *ctx = mont_ctx_new(length, M);
+			for (uint32_t m = 0; m < 3; m++) {
+				ctx->mode = modes[m];
+				mod_exp_ctx(ctx, X, E, expected);
+				mod_exp_le_ctx(ctx, X64, E64, Z64);
+				u64_to_array(length64, Z64, length, Z);
+				assertArrayEquals(length, expected, Z);
+			}
+			mont_ctx_free(ctx);
+		}
+	}
+	mont_dispatch_init(getenv("MONT_BACKEND"));
+}
+
+void test_mont_domain() {
+	printf("=== test_mont_domain ===\n");
+	// Z := ((X * Y)^2)^E computed in the domain, in place, against
+	// mod_exp_ctx of the square of X * Y mod M taken outside it.
+	uint32_t X[33], Y[33], M[33], E[33], A[33], B[33], T[33], expected[33];
+	const uint32_t lengths[] = { 33, 32, 7 };
+	const uint32_t modes[] = { MONT_EXP_MODE_PUBLIC_FAST,
+			MONT_EXP_MODE_SECRET_SECURE, MONT_EXP_MODE_SECRET_LADDER };
+	const char *backends[] = { "uint32", NULL };
+	uint32_t x = 0xd0a1115e;
+	for (uint32_t b = 0; b < 2; b++) {
+		mont_dispatch_init(backends[b]);
+		for (uint32_t l = 0; l < 3; l++) {
+			const uint32_t length = lengths[l];
+			for (uint32_t i = 0; i < length; i++) {
+				x = x * 1664525 + 1013904223;
+				X[i] = x >> 1;
+				M[i] = x | 0x80000000;
+				x = x * 1664525 + 1013904223;
+				Y[i] = x >> 1;
+				E[i] = x;
+			}
+			M[length - 1] |= 1;
+			mont_ctx *ctx = mont_ctx_new(length, M);
+
+			// T := (X * Y mod M)^2 mod M with the uint32_t R.
+			mont_prod_cios_array(length, X, Y, M, ctx->n0, A);
+			mont_prod_cios_array(length, A, ctx->Nr, M, ctx->n0, T);
+			mont_prod_cios_array(length, T, T, M, ctx->n0, A);
+			mont_prod_cios_array(length, A, ctx->Nr, M, ctx->n0, T);
+
+			to_mont_ctx(ctx, X, A);
+			from_mont_ctx(ctx, A, B);
+			assertArrayEquals(length, X, B);
+			for (uint32_t m = 0; m < 3; m++) {
+				ctx->mode = modes[m];
+				mod_exp_ctx(ctx, T, E, expected);
+				to_mont_ctx(ctx, X, A);
+				copy_array(length, Y, B);
+				to_mont_ctx(ctx, B, B);
+				mont_mul_ctx(ctx, A, B, A);
+				mont_sqr_ctx(ctx, A, A);
+				mont_exp_in_domain_ctx(ctx, A, E, A);
+				from_mont_ctx(ctx, A, A);
+				assertArrayEquals(length, expected, A);
+			}
+			mont_ctx_free(ctx);
+		}
+	}
+	mont_dispatch_init(getenv("MONT_BACKEND"));
+}
+
+void test_mod_exp_trim() {
+	printf("=== test_mod_exp_trim ===\n");
+	// Operands padded with leading zero words, a 3 word modulus in 9, with
+	// the exponent, then the base, longer than the modulus, against
+	// mod_exp_ctx at the padded length, which runs every word.
+	uint32_t X[9], E[9], M[9], Z[9], T[9], TWO[9], expected[9];
+	uint32_t *Xs[] = { X, X };
+	uint32_t *Es[] = { E, E };
+	void *workspace = calloc(1, mont_ctx_workspace_size(9));
+	if (workspace == NULL) die("calloc");
+	zero_array(9, TWO);
+	TWO[8] = 2;
+	uint32_t x = 0x7e11ade5;
+	for (uint32_t c = 0; c < 3; c++) {
+		zero_array(9, X);
+		zero_array(9, E);
+		zero_array(9, M);
+		for (uint32_t i = 6; i < 9; i++) {
+			x = x * 1664525 + 1013904223;
+			X[i] = x >> 1;
+			M[i] = x;
+			x = x * 1664525 + 1013904223;
+			E[i] = x;
+		}
+		M[6] = (M[6] >> 4) | 1;
+		M[8] |= 1;
+		if (c == 1)
+			E[4] = 0x5eed;
+		if (c == 2)
+			X[5] = 0x3;
+		mont_ctx *ctx = mont_ctx_new(9, M);
+		ctx->mode = MONT_EXP_MODE_PUBLIC_FAST;
+		mod_exp_ctx(ctx, X, E, expected);
+
+		for (uint32_t i = 0; i < 9; i++)
+			Z[i] = 0xdeadbeef;
+		mod_exp_array(9, X, E, M, Z);
+		assertArrayEquals(9, expected, Z);
+		for (uint32_t i = 0; i < 9; i++)
+			Z[i] = 0xdeadbeef;
+		mod_exp_ws_array(9, X, E, M, Z, workspace);
+		assertArrayEquals(9, expected, Z);
+		for (uint32_t i = 0; i < 9; i++)
+			Z[i] = 0xdeadbeef;
+		mod_exp_array2(9, 9, X, E, M, Z);
+		assertArrayEquals(9, expected, Z);
+		// The exponent without its top two words.
+		mod_exp_array2(7, 9, X, E + 2, M, Z);
+		assertArrayEquals(9, expected, Z);
+
+		// X^E * X^E.
+		mod_exp_ctx(ctx, expected, TWO, T);
+		mod_exp_multi_array(9, 2, Xs, Es, M, Z);
+		assertArrayEquals(9, T, Z);
+		mont_ctx_free(ctx);
+	}
+	free(workspace);
+}
+
+void test_mod_exp_lazy() {
+	printf("=== test_mod_exp_lazy ===\n");
+	// Every mode with the 64 bit limbs reducing lazily and eagerly against
+	// the uint32_t backend, for moduli with the two clear top bits lazy
+	// reduction needs (odd length, or M[0] >>= 2) and without, the longest
+	// going through the Karatsuba products.
+	uint32_t X[258], M[258], E[258], Z[258], expected[258];
+	const uint32_t lengths[] = { 33, 32, 32, 258 };
+	const uint32_t modes[] = { MONT_EXP_MODE_PUBLIC_FAST,
+			MONT_EXP_MODE_SECRET_SECURE, MONT_EXP_MODE_SECRET_LADDER };
+	uint32_t x = 0x1a2ea5ed;
+	for (uint32_t l = 0; l < 4; l++) {
+		const uint32_t length = lengths[l];
+		for (uint32_t i = 0; i < length; i++) {
+			x = x * 1664525 + 1013904223;
+			X[i] = x >> 1;
+			M[i] = x | 0x80000000;
+			x = x * 1664525 + 1013904223;
+			E[i] = x;
+		}
+		M[length - 1] |= 1;
+		if (l == 2) {
+			M[0] >>= 2;
+			X[0] >>= 2;
+		}
+		for (uint32_t m = 0; m < 3; m++) {
+			mont_dispatch_init("uint32");
+			mont_ctx *ctx = mont_ctx_new(length, M);
+			ctx->mode = modes[m];
+			mod_exp_ctx(ctx, X, E, expected);
+			mont_ctx_free(ctx);
+
+			mont_dispatch_init(getenv("MONT_BACKEND"));
+			ctx = mont_ctx_new(length, M);
+			ctx->mode = modes[m];
+#ifdef MONT_HAVE_UINT64
+			// Short of MONT_KARATSUBA_LIMBS, forced on to cover it.
+			if ((ctx->u64 != NULL) && (length == 258))
+				ctx->u64->karatsuba = 1;
+#endif
+			mod_exp_ctx(ctx, X, E, Z);
+			assertArrayEquals(length, expected, Z);
+#ifdef MONT_HAVE_UINT64
+			if (ctx->u64 != NULL) {
+				ctx->u64->lazy = 0;
+				mod_exp_ctx(ctx, X, E, Z);
+				assertArrayEquals(length, expected, Z);
+			}
+#endif
+			mont_ctx_free(ctx);
+		}
+	}
+	mont_dispatch_init(getenv("MONT_BACKEND"));
+}
+
+// Saves the checkpoint of test_mont_sqr_chain and stops the run at 49.
+static int test_mont_sqr_chain_checkpoint(void *arg, uint64_t done,
+		uint32_t *X) {
+	uint32_t *saved = arg;
+	saved[0] = (uint32_t) done;
+	copy_array(saved[1], X, saved + 2);
+	return done == 49;
+}
+
+void test_mont_sqr_chain() {
+	printf("=== test_mont_sqr_chain ===\n");
+	// X ** (2^100) against mod_exp_ctx, for moduli with and without the
+	// two clear top bits that let the 64 bit limbs reduce lazily, in one
+	// run and in one stopped at a checkpoint and resumed.
+	uint32_t X[33], M[33], E[33], Z[33], expected[33], saved[35];
+	const uint32_t lengths[] = { 33, 32, 8 };
+	const char *backends[] = { "uint32", NULL };
+	uint32_t x = 0x71e10c4e;
+	for (uint32_t b = 0; b < 2; b++) {
+		mont_dispatch_init(backends[b]);
+		for (uint32_t l = 0; l < 3; l++) {
+			const uint32_t length = lengths[l];
+			for (uint32_t i = 0; i < length; i++) {
+				x = x * 1664525 + 1013904223;
+				X[i] = x >> 1;
+				M[i] = x | 0x80000000;
+			}
+			M[length - 1] |= 1;
+			if (length == 8) {
+				M[0] >>= 2;
+				X[0] >>= 2;
+			}
+			zero_array(length, E);
+			E[length - 1 - 100 / 32] = 1u << (100 % 32);
+			mont_ctx *ctx = mont_ctx_new(length, M);
+			mod_exp_ctx(ctx, X, E, expected);
+
+			copy_array(length, X, Z);
+			uint64_t done = mod_sqr_chain_ctx(ctx, Z, 100, 0, 0, NULL, NULL);
+			uint32_t count[] = { (uint32_t) done };
+			uint32_t expected_count[] = { 100 };
+			assertArrayEquals(1, expected_count, count);
+			assertArrayEquals(length, expected, Z);
+
+			saved[1] = length;
+			copy_array(length, X, Z);
+			done = mod_sqr_chain_ctx(ctx, Z, 100, 0, 7, test_mont_sqr_chain_checkpoint,
+					saved);
+			count[0] = (uint32_t) done;
+			expected_count[0] = 49;
+			assertArrayEquals(1, expected_count, count);
+			assertArrayEquals(length, saved + 2, Z);
+			copy_array(length, saved + 2, Z);
+			done = mod_sqr_chain_ctx(ctx, Z, 100, saved[0], 7,
+					test_mont_sqr_chain_checkpoint, saved);
+			assertArrayEquals(length, expected, Z);
+			// The last checkpoint is the one at 98.
+			count[0] = saved[0];
+			expected_count[0] = 98;
+			assertArrayEquals(1, expected_count, count);
+			mont_ctx_free(ctx);
+		}
+	}
+	mont_dispatch_init(getenv("MONT_BACKEND"));
+}
+
+void test_mod_exp_crt() {
+	printf("=== test_mod_exp_crt ===\n");
+	// 2x64 bit key, N with a leading zero word and q > p.
+	uint32_t X[] = { 0x00000000, 0x198eb4ef, 0x2be53c1f, 0x881931f9, 0x55b7ceaa };
+	uint32_t E[] = { 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00010001 };
+	uint32_t p[] = { 0xcf126160, 0x278deda9 };
+	uint32_t q[] = { 0xed761d81, 0x32bd65a9 };
+	uint32_t dP[] = { 0x1e6bb8da, 0x83751a61 };
+	uint32_t dQ[] = { 0xe7a1a7f6, 0x374078c1 };
+	uint32_t qInv[] = { 0x67e24757, 0x9bf6cf58 };
+	uint32_t expected[] = { 0x00000000, 0x14b272fc, 0xd3e3cb1a, 0x29a96442, 0x98a46e89 };
+	uint32_t ONE[] = { 1 };
+	uint32_t ZERO[] = { 0, 0, 0, 0, 0 };
+	uint32_t Z[5];
+
+	uint32_t ok[] = { (uint32_t) mod_exp_crt_array(5, 2, X, p, q, dP, dQ,
+			qInv, E, Z) };
+	assertArrayEquals(1, ONE, ok);
+	assertArrayEquals(5, expected, Z);
+	mod_exp_crt_array(5, 2, X, p, q, dP, dQ, qInv, NULL, Z);
+	assertArrayEquals(5, expected, Z);
+
+	// A fault in one half is caught by the check and nothing is released.
+	mont_crt_ctx *ctx = mont_crt_ctx_new(5, 2, p, q, dP, dQ, qInv, E);
+	ctx->dQ[1] ^= 4;
+	ok[0] = (uint32_t) mod_exp_crt_ctx(ctx, X, Z);
+	assertArrayEquals(1, ZERO, ok);
+	assertArrayEquals(5, ZERO, Z);
+	mont_crt_ctx_free(ctx);
+}
+
+void test_mod_exp_crt_1024() {
+	printf("=== test_mod_exp_crt_1024 ===\n");
+	uint32_t X[] = { 0x7a374868, 0x7864bb97, 0xc65b56fc, 0xde996f71, 0xa459e4c6,
+			0x1387aba7, 0xae1b7266, 0xc65105ef, 0xf4c129d4, 0x9c1aaadc,
+			0x3b63b297, 0x2302bb33, 0x68548aa5, 0x9087ddc8, 0x3df92746,
+			0x0e90b8a4, 0x39ff724d, 0x00750173, 0x459a0778, 0xa4353b6d,
+			0x32ee3681, 0x1ebdf389, 0x7a70e870, 0x1a2c174f, 0x23ddd7f6,
+			0x0c2e3d58, 0x831aa357, 0xd2a7378e, 0x690dc4c7, 0x1ec68c85,
+			0x9558310f, 0xf6cf5e7a };
+	uint32_t p[] = { 0xd2a74d42, 0x5475f5ed, 0x0a38b19b, 0xbc35f187, 0x712b5296,
+			0xcbe452b8, 0xa2cafbac, 0xef7ac25f, 0x9f092669, 0xa8668e7e,
+			0x62731fe3, 0x5b8f4d81, 0x1008cf64, 0x095c9994, 0x9123654a,
+			0xe1afe079 };
+	uint32_t q[] = { 0xce7b9c54, 0x9ce76ce6, 0xfe2ba76f, 0x70a3ec7e, 0xacb815a5,
+			0xbaa24b27, 0x52010776, 0xf77357c2, 0x70bbecb2, 0x05eb0a36,
+			0x551f6439, 0xb175dae6, 0x125fb6c4, 0x1df30013, 0x437897d7,
+			0xd13c65b7 };
+	uint32_t dP[] = { 0xb63c75e2, 0x041f6879, 0x80763b70, 0x770a53c0, 0xd06ea22c,
+			0x42876be8, 0xbf2ccb3d, 0x788fc2c7, 0xe6558c1d, 0xabc9cd4c,
+			0x18ef6f8e, 0xc90ed805, 0xe75137d9, 0x5b1ff8dd, 0x461250f6,
+			0xcef7d041 };
+	uint32_t dQ[] = { 0x036cbb70, 0x0fd62ad1, 0x3dfffd5b, 0xf4d35335, 0xdaa986fa,
+			0x63b91364, 0x089129cd, 0x88572a6a, 0x783235bf, 0xd2274ed9,
+			0x0dda6270, 0x2e8854e4, 0x2203e265, 0x28560277, 0x4f542db8,
+			0x8fa8dfcb };
+	uint32_t qInv[] = { 0x713cc7fb, 0x4c502b64, 0x3366a847, 0x7e8814db, 0x3ad82a89,
+			0xabb0ed6d, 0xad7ad896, 0x9ddd4bd3, 0xeb8949df, 0x0c31b93d,
+			0xa031296f, 0x6521ba20, 0x9d977806, 0x1cd69453, 0x809f656e,
+			0xc9e6a31f };
+	uint32_t expected[] = { 0x35efdca9, 0x3cb3b004, 0xeaf2fd2e, 0x351f90e8, 0x7d0e11a1,
+			0x81638233, 0xb194ddea, 0xfd2cfea8, 0x2b53b0e6, 0xb7193927,
+			0xc182d5b4, 0x064363f5, 0xf24d3297, 0x355b4dfb, 0xf158c4a3,
+			0x87c66637, 0xe52ecc88, 0x7ae1ec80, 0x0ad74d97, 0xebcad3e7,
+			0xdfbdf987, 0x1642e291, 0x6f451eca, 0x115fd878, 0x26081124,
+			0x9f06e80b, 0xa45442b8, 0xe8db148e, 0x92e37b5d, 0xa42d4411,
+			0xc7cda69d, 0x5654ffcb };
+	uint32_t E[32] = { 0 };
+	uint32_t ONE[] = { 1 };
+	uint32_t Z[32];
+	E[31] = 0x00010001;
+
+	// Twice, the context is reused.
+	mont_crt_ctx *ctx = mont_crt_ctx_new(32, 16, p, q, dP, dQ, qInv, E);
+	for (uint32_t k = 0; k < 2; k++) {
+		uint32_t ok[] = { (uint32_t) mod_exp_crt_ctx(ctx, X, Z) };
+		assertArrayEquals(1, ONE, ok);
+		assertArrayEquals(32, expected, Z);
+	}
+
+	// Round trips Y ** d of Y = V ** E mod N, for V = N - 1, whose
+	// reductions mod p and q use every bit of the chunks, and random V < N.
+	uint32_t V[32], Y[32];
+	uint32_t x = 0x5ec12e75;
+	for (uint32_t k = 0; k < 4; k++) {
+		copy_array(32, ctx->n->M, V);
+		if (k == 0) {
+			V[31] -= 1;
+		} else {
+			for (uint32_t i = 1; i < 32; i++) {
+				x = x * 1664525 + 1013904223;
+				V[i] = x;
+			}
+			V[0] >>= 1;
+		}
+		mod_exp_array(32, V, E, ctx->n->M, Y);
+		uint32_t ok[] = { (uint32_t) mod_exp_crt_ctx(ctx, Y, Z) };
+		assertArrayEquals(1, ONE, ok);
+		assertArrayEquals(32, V, Z);
+	}
+	mont_crt_ctx_free(ctx);
+}
+
+void test_mod_exp_backends() {
+	printf("=== test_mod_exp_backends ===\n");
+	uint32_t X[] = { 0, (1 << (61 - 32)) - 1, 0xffffffff }; //2^61-1
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t E[] = { 0x01234567, 0x89abcdef, 0x7fffffff };
+	uint32_t expected[] = { 0x018cc964, 0x11be03e2, 0x9973f1dd };
+	uint32_t Z[3];
+
+	mont_ctx *ctx = mont_ctx_new(3, M);
+	for (uint32_t backend = MONT_BACKEND_UINT32; backend <= MONT_BACKEND_IFMA;
+			backend++) {
+		if ((backend == MONT_BACKEND_UINT64) && (ctx->u64 == NULL))
+			continue;
+		if ((backend == MONT_BACKEND_IFMA) && (ctx->ifma == NULL))
+			continue;
+		ctx->backend = backend;
+		for (uint32_t mode = MONT_EXP_MODE_SECRET_SECURE;
+				mode <= MONT_EXP_MODE_SECRET_LADDER; mode++) {
+			ctx->mode = mode;
+			mod_exp_ctx(ctx, X, E, Z);
+			assertArrayEquals(3, expected, Z);
+		}
+	}
+	mont_ctx_free(ctx);
+}
+
+void test_mod_exp_batch() {
+	printf("=== test_mod_exp_batch ===\n");
+	uint32_t X[] = { 0, (1 << (61 - 32)) - 1, 0xffffffff }; //2^61-1
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t M2[] = { 0x00ffffff, 0x12345678, 0x9abcdef1 };
+	uint32_t E[] = { 0x01234567, 0x89abcdef, 0x7fffffff };
+	uint32_t E2[] = { 0, 0, 0x00010001 };
+	uint32_t expected[] = { 0x018cc964, 0x11be03e2, 0x9973f1dd };
+	uint32_t Zs[6][3];
+	uint32_t Zk[3];
+	uint32_t *Xb[6], *Eb[6], *Mb[6], *Zb[6];
+
+	// Six entries, the first three share M.
+	for (uint32_t k = 0; k < 6; k++) {
+		Xb[k] = X;
+		Eb[k] = (k & 1) ? E2 : E;
+		Mb[k] = (k < 3) ? M : M2;
+		Zb[k] = Zs[k];
+	}
+	mod_exp_batch(6, 3, Xb, Eb, Mb, Zb);
+	assertArrayEquals(3, expected, Zs[0]);
+	for (uint32_t k = 1; k < 6; k++) {
+		mod_exp_array(3, Xb[k], Eb[k], Mb[k], Zk);
+		assertArrayEquals(3, Zk, Zs[k]);
+	}
+}
+
+void test_mont_dispatch() {
+	printf("=== test_mont_dispatch ===\n");
+	uint32_t X[] = { 0, (1 << (61 - 32)) - 1, 0xffffffff }; //2^61-1
+	uint32_t M[] = { (1 << (89 - 64)) - 1, 0xffffffff, 0xffffffff }; //2^89-1
+	uint32_t E[] = { 0x01234567, 0x89abcdef, 0x7fffffff };
+	uint32_t E2[] = { 0, 0, 0x00010001 };
+	uint32_t expected[] = { 0x018cc964, 0x11be03e2, 0x9973f1dd };
+	uint32_t expected2[3];
+	uint32_t Z[3];
+	uint32_t Zb[2][3];
+	uint32_t *Xb[] = { X, X }, *Eb[] = { E, E2 }, *Mb[] = { M, M };
+	uint32_t *Zp[] = { Zb[0], Zb[1] };
+	const char *backends[] = { "uint32", "uint64", "adx", "ifma" };
+
+	mont_dispatch_init("uint32");
+	mod_exp_array(3, X, E2, M, expected2);
+	for (uint32_t k = 0; k < 4; k++) {
+		mont_dispatch_init(backends[k]);
+		const mont_dispatch *d = mont_get_dispatch();
+		uint32_t extra[] = { d->features & ~d->detected };
+		uint32_t none[] = { 0 };
+		assertArrayEquals(1, none, extra);
+
+		mod_exp_array(3, X, E, M, Z);
+		assertArrayEquals(3, expected, Z);
+		mod_exp_array(3, X, E2, M, Z);
+		assertArrayEquals(3, expected2, Z);
+		mod_exp_batch(2, 3, Xb, Eb, Mb, Zp);
+		assertArrayEquals(3, expected, Zb[0]);
+		assertArrayEquals(3, expected2, Zb[1]);
+	}
+#ifdef MONT_HAVE_UINT64
+	// A context keeps the kernels it was made with.
+	mont_dispatch_init("uint64");
+	mont_ctx *ctx = mont_ctx_new(3, M);
+	mont_dispatch_init(NULL);
+	uint32_t kept[] = { ctx->u64->prod == mont_prod_u64_portable };
+	uint32_t one[] = { 1 };
+	assertArrayEquals(1, one, kept);
+	mod_exp_ctx(ctx, X, E, Z);
+	assertArrayEquals(3, expected, Z);
+	mont_ctx_free(ctx);
+#endif
+	uint32_t unknown[] = { (uint32_t) mont_dispatch_init("sse9") };
+	uint32_t zero[] = { 0 };
+	assertArrayEquals(1, zero, unknown);
+	mont_dispatch_init(getenv("MONT_BACKEND"));
+}
+
 void test_modExp_4096bit_e65537() {
 	printf("=== test_modExp_4096bit_e65537 ===\n");
 	uint32_t M[] = { 0x00000000, 0xecc9307c, 0x57a39970, 0x7e9e2569, 0x872cd790,
@@ -683,9 +1730,43 @@ void montgomery_array_tests(int bigtests) {
   testSub();
   test_montgomery_one_item_array();
   test_montgomery_modulus();
+  test_divmod();
+  test_mont_prod_cios();
+  test_mont_sqr();
+#ifdef MONT_HAVE_UINT64
+  test_mont_prod_u64_fixed();
+#endif
+#if defined(MONT_HAVE_UINT64) && defined(MONT_HAVE_ADX)
+  test_mont_prod_adx();
+#endif
+#ifdef MONT_HAVE_UINT64
+  test_mont_prod_karatsuba();
+#endif
+#ifdef MONT_HAVE_IFMA
+  test_mont_prod_ifma();
+#endif
+  test_m_residue_fast();
 
   // modexp tests.
   test_montgomery_modexp();
+  test_mod_exp_ctx();
+  test_mod_exp_window();
+  test_mod_exp_secret();
+  test_mod_exp_public();
+  test_mod_exp_multi();
+  test_mod_exp_comb();
+  test_mod_exp_crt();
+  test_mod_exp_pool();
+  test_mod_exp_ws();
+  test_mod_exp_le();
+  test_mont_domain();
+  test_mont_sqr_chain();
+  test_mod_exp_lazy();
+  test_mod_exp_trim();
+  test_mod_exp_crt_1024();
+  test_mod_exp_backends();
+  test_mod_exp_batch();
+  test_mont_dispatch();
 
   // Fairly big.
   test_modExp_4096bit_e65537();
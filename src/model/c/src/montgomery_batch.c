@@ -0,0 +1,23 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bignum_uint32_t.h"
+#include "montgomery_array.h"
+#include "montgomery_batch.h"
+
+// Z[k] := X[k] ** E[k] mod M[k] for k < count. The moduli are odd and every
+// operand is length words, E[k] included. A modulus shared by consecutive
+// entries is passed as the same pointer, its mont_ctx is then made once.
+// Every exponentiation runs in the default secret mode on the dispatched
+// backend, so the time only depends on count and length.
+void mod_exp_batch(uint32_t count, uint32_t length, uint32_t **X, uint32_t **E,
+		uint32_t **M, uint32_t **Z) {
+	mont_ctx *ctx = NULL;
+	for (uint32_t k = 0; k < count; k++) {
+		if ((ctx == NULL) || (M[k] != M[k - 1])) {
+			mont_ctx_free(ctx);
+			ctx = mont_ctx_new(length, M[k]);
+		}
+		mod_exp_ctx(ctx, X[k], E[k], Z[k]);
+	}
+	mont_ctx_free(ctx);
+}
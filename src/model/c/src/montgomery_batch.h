@@ -0,0 +1,17 @@
+/*
+ * montgomery_batch.h
+ *
+ *  Batches of independent modular exponentiations X[k] ** E[k] mod M[k].
+ *  Operands are the usual big endian uint32_t arrays, all of the same
+ *  length.
+ */
+
+#ifndef MONTGOMERY_BATCH_H_
+#define MONTGOMERY_BATCH_H_
+
+#include <stdint.h>
+
+void mod_exp_batch(uint32_t count, uint32_t length, uint32_t **X, uint32_t **E,
+		uint32_t **M, uint32_t **Z);
+
+#endif /* MONTGOMERY_BATCH_H_ */
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bignum_uint32_t.h"
+#include "montgomery_array.h"
+#include "montgomery_uint64_t.h"
+#include "montgomery_comb.h"
+
+// Table index for block k, column col: bit i is exponent bit
+// i*a + k*b + col, zero past the end of the row or of the exponent.
+// Which bits are read only depends on the comb's shape.
+static uint32_t comb_index(mont_comb *comb, uint32_t *E, uint32_t k,
+		uint32_t col) {
+	const uint32_t offset = k * comb->b + col;
+	uint32_t index = 0;
+	if (offset >= comb->a)
+		return 0;
+	for (uint32_t i = 0; i < comb->teeth; i++) {
+		uint32_t bit = i * comb->a + offset;
+		if (bit < 32 * comb->length)
+			index |= exp_bit_array(comb->length, E, bit) << i;
+	}
+	return index;
+}
+
+// Builds comb->table from G: the single powers by repeated squaring of
+// MontProd( G, Nr ), then every other entry as the product of the entry
+// without its lowest row and the lowest row's power.
+static void mont_comb_init_array(mont_comb *comb, uint32_t *G) {
+	mont_ctx *ctx = comb->ctx;
+	const uint32_t length = comb->length;
+	const uint32_t entries = 1u << comb->teeth;
+	uint32_t *P = ctx->P;
+
+	mont_prod_cios_array(length, G, ctx->Nr, ctx->M, ctx->n0, P);
+	uint32_t pos = 0;
+	for (uint32_t i = 0; i < comb->teeth; i++) {
+		for (uint32_t k = 0; k < comb->blocks; k++) {
+			for (; pos < i * comb->a + k * comb->b; pos++)
+				mont_sqr_array(length, P, ctx->M, ctx->n0, ctx->temp2, P);
+			copy_array(length, P,
+					comb->table + (k * entries + (1u << i)) * length);
+		}
+	}
+	for (uint32_t k = 0; k < comb->blocks; k++) {
+		uint32_t *t = comb->table + k * entries * length;
+		copy_array(length, ctx->Rm, t);
+		for (uint32_t j = 3; j < entries; j++) {
+			if ((j & (j - 1)) == 0)
+				continue;
+			mont_prod_cios_array(length, t + (j & (j - 1)) * length,
+					t + (j & (0 - j)) * length, ctx->M, ctx->n0, t + j * length);
+		}
+	}
+}
+
+// One squaring per column and one multiplication per block and column,
+// by a masked table lookup also where the index is 0, so the sequence of
+// operations only depends on the comb's shape.
+static void mod_exp_comb_array(mont_comb *comb, uint32_t *E, uint32_t *Z) {
+	mont_ctx *ctx = comb->ctx;
+	const uint32_t length = comb->length;
+	const uint32_t entries = 1u << comb->teeth;
+
+	// The running product moves between Z and ctx->P, the entry goes to
+	// temp2, which is free between the squarings.
+	uint32_t *z = Z;
+	uint32_t *entry = ctx->temp2 + length;
+	copy_array(length, ctx->Rm, z);
+	for (int32_t col = ((int32_t) comb->b) - 1; col >= 0; col--) {
+		if (col != ((int32_t) comb->b) - 1)
+			mont_sqr_array(length, z, ctx->M, ctx->n0, ctx->temp2, z);
+		for (uint32_t k = 0; k < comb->blocks; k++) {
+			mont_table_select_array(length, comb->table + k * entries * length,
+					entries, comb_index(comb, E, k, (uint32_t) col), entry);
+			uint32_t *next = (z == Z) ? ctx->P : Z;
+			mont_prod_cios_array(length, z, entry, ctx->M, ctx->n0, next);
+			z = next;
+		}
+	}
+	mont_redc_array(length, ctx->M, ctx->n0, z);
+	if (z != Z)
+		copy_array(length, z, Z);
+}
+
+#ifdef MONT_HAVE_UINT64
+
+// mont_comb_init_array with 64 bit limbs.
+static void mont_comb_init_u64(mont_comb *comb, uint32_t *G) {
+	mont_ctx_u64 *ctx = comb->ctx->u64;
+	const uint32_t n = ctx->length;
+	const uint32_t entries = 1u << comb->teeth;
+	uint64_t *P = ctx->P;
+
+	array_to_u64(comb->length, G, n, ctx->X);
+	ctx->prod(n, ctx->X, ctx->Nr, ctx->M, ctx->n0, P);
+	uint32_t pos = 0;
+	for (uint32_t i = 0; i < comb->teeth; i++) {
+		for (uint32_t k = 0; k < comb->blocks; k++) {
+			for (; pos < i * comb->a + k * comb->b; pos++)
+				ctx->sqr(n, P, ctx->M, ctx->n0, ctx->temp2, P);
+			copy_u64(n, P, comb->table64 + (k * entries + (1u << i)) * n);
+		}
+	}
+	for (uint32_t k = 0; k < comb->blocks; k++) {
+		uint64_t *t = comb->table64 + k * entries * n;
+		copy_u64(n, ctx->Rm, t);
+		for (uint32_t j = 3; j < entries; j++) {
+			if ((j & (j - 1)) == 0)
+				continue;
+			ctx->prod(n, t + (j & (j - 1)) * n, t + (j & (0 - j)) * n,
+					ctx->M, ctx->n0, t + j * n);
+		}
+	}
+}
+
+// mod_exp_comb_array with 64 bit limbs.
+static void mod_exp_comb_u64(mont_comb *comb, uint32_t *E, uint32_t *Z) {
+	mont_ctx_u64 *ctx = comb->ctx->u64;
+	const uint32_t n = ctx->length;
+	const uint32_t entries = 1u << comb->teeth;
+	uint64_t *Z64 = ctx->Z;
+	uint64_t *entry = ctx->temp2 + n;
+
+	copy_u64(n, ctx->Rm, Z64);
+	for (int32_t col = ((int32_t) comb->b) - 1; col >= 0; col--) {
+		if (col != ((int32_t) comb->b) - 1)
+			ctx->sqr(n, Z64, ctx->M, ctx->n0, ctx->temp2, Z64);
+		for (uint32_t k = 0; k < comb->blocks; k++) {
+			mont_table_select_u64(n, comb->table64 + k * entries * n, entries,
+					comb_index(comb, E, k, (uint32_t) col), entry);
+			uint64_t *next = (Z64 == ctx->Z) ? ctx->P : ctx->Z;
+			ctx->prod(n, Z64, entry, ctx->M, ctx->n0, next);
+			Z64 = next;
+		}
+	}
+	mont_redc_u64(n, ctx->M, ctx->n0, Z64);
+	u64_to_array(n, Z64, comb->length, Z);
+}
+
+#endif /* MONT_HAVE_UINT64 */
+
+// Comb for G ** E mod M with 2^teeth table entries per block, teeth at most
+// MONT_COMB_TEETH_MAX. More teeth make every exponentiation cheaper, more
+// blocks cut the squarings; both multiply the table size. 0 picks
+// MONT_COMB_TEETH and MONT_COMB_BLOCKS. The table uses the 64 bit limb
+// backend if mont_ctx_new picks one of the 64 bit backends for M.
+mont_comb *mont_comb_new(uint32_t length, uint32_t *G, uint32_t *M,
+		uint32_t teeth, uint32_t blocks) {
+	const uint32_t nbits = 32 * length;
+	mont_comb *comb = calloc(1, sizeof(mont_comb));
+	if (comb == NULL) die("calloc");
+	if (teeth == 0)
+		teeth = MONT_COMB_TEETH;
+	if (teeth > MONT_COMB_TEETH_MAX)
+		teeth = MONT_COMB_TEETH_MAX;
+	if (blocks == 0)
+		blocks = MONT_COMB_BLOCKS;
+	comb->length = length;
+	comb->teeth = teeth;
+	comb->a = (nbits + teeth - 1) / teeth;
+	comb->b = (comb->a + blocks - 1) / blocks;
+	// Drop blocks that would start past the end of a row.
+	comb->blocks = (comb->a + comb->b - 1) / comb->b;
+	comb->ctx = mont_ctx_new(length, M);
+	const size_t entries = (size_t) comb->blocks << teeth;
+
+#ifdef MONT_HAVE_UINT64
+	if ((comb->ctx->backend != MONT_BACKEND_UINT32) && (comb->ctx->u64 != NULL)) {
+		comb->table64 = calloc(entries * comb->ctx->u64->length, sizeof(uint64_t));
+		if (comb->table64 == NULL) die("calloc");
+		mont_comb_init_u64(comb, G);
+		return comb;
+	}
+#endif
+	comb->table = calloc(entries * length, sizeof(uint32_t));
+	if (comb->table == NULL) die("calloc");
+	mont_comb_init_array(comb, G);
+	return comb;
+}
+
+void mont_comb_free(mont_comb *comb) {
+	if (comb == NULL)
+		return;
+	mont_ctx_free(comb->ctx);
+	free(comb->table);
+	free(comb->table64);
+	free(comb);
+}
+
+// Z := G ** E mod M, in time independent of the value of E.
+void mod_exp_comb(mont_comb *comb, uint32_t *E, uint32_t *Z) {
+#ifdef MONT_HAVE_UINT64
+	if (comb->table64 != NULL) {
+		mod_exp_comb_u64(comb, E, Z);
+		return;
+	}
+#endif
+	mod_exp_comb_array(comb, E, Z);
+}
@@ -0,0 +1,44 @@
+/*
+ * montgomery_comb.h
+ *
+ *  Fixed base exponentiation with a Lim-Lee comb: G ** E mod M for one
+ *  base and modulus and many exponents, from a table built once per
+ *  (G, M). Operands are the usual big endian uint32_t arrays of length
+ *  words, E included.
+ */
+
+#ifndef MONTGOMERY_COMB_H_
+#define MONTGOMERY_COMB_H_
+
+#include <stdint.h>
+#include "montgomery_array.h"
+
+// Defaults for mont_comb_new's teeth and blocks of 0: 2 * 2^6 table
+// entries, e.g. 32 KiB at 2048 bits.
+#define MONT_COMB_TEETH     6
+#define MONT_COMB_BLOCKS    2
+#define MONT_COMB_TEETH_MAX 10
+
+// The 32*length exponent bits are split into teeth rows of a bits, each
+// row into blocks blocks of b bits. table holds, per block k, the 2^teeth
+// products of G^(2^(i*a + k*b)) over the rows i in the entry's index, in
+// the Montgomery domain of the ctx backend: table64 for the 64 bit limb
+// backend, table otherwise. An exponentiation then costs b - 1
+// squarings and blocks * b (about a) multiplications.
+typedef struct {
+	uint32_t length;
+	uint32_t teeth;
+	uint32_t blocks;
+	uint32_t a;
+	uint32_t b;
+	mont_ctx *ctx;
+	uint32_t *table;
+	uint64_t *table64;
+} mont_comb;
+
+mont_comb *mont_comb_new(uint32_t length, uint32_t *G, uint32_t *M,
+		uint32_t teeth, uint32_t blocks);
+void mont_comb_free(mont_comb *comb);
+void mod_exp_comb(mont_comb *comb, uint32_t *E, uint32_t *Z);
+
+#endif /* MONTGOMERY_COMB_H_ */
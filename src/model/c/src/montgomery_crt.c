@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bignum_uint32_t.h"
+#include "montgomery_array.h"
+#include "montgomery_crt.h"
+
+static uint32_t *crt_calloc(uint32_t words) {
+	uint32_t *a = calloc(words, sizeof(uint32_t));
+	if (a == NULL) die("calloc");
+	return a;
+}
+
+// Z (length words) := a (alength words), dropping or adding leading zero
+// words.
+static void crt_resize(uint32_t alength, uint32_t *a, uint32_t length,
+		uint32_t *Z) {
+	for (uint32_t i = 0; i < length; i++)
+		Z[length - 1 - i] = (i < alength) ? a[alength - 1 - i] : 0;
+}
+
+// d := a - b mod M for a, b < M, adding M back under a mask instead of a
+// branch on the borrow. d may overlap a or b.
+static void crt_sub_mod(uint32_t length, uint32_t *a, uint32_t *b, uint32_t *M,
+		uint32_t *d) {
+	uint64_t borrow = 0;
+	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--) {
+		uint64_t r = (uint64_t) a[i] - b[i] - borrow;
+		d[i] = (uint32_t) r;
+		borrow = (r >> 32) & 1;
+	}
+	const uint32_t mask = (uint32_t) 0 - (uint32_t) borrow;
+	uint64_t carry = 0;
+	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--) {
+		uint64_t r = (uint64_t) d[i] + (M[i] & mask) + carry;
+		d[i] = (uint32_t) r;
+		carry = r >> 32;
+	}
+}
+
+// d := a + b mod M for a, b < M, subtracting M and adding it back under a
+// mask where that borrowed and the sum did not carry. d may overlap a or b.
+static void crt_add_mod(uint32_t length, uint32_t *a, uint32_t *b, uint32_t *M,
+		uint32_t *d) {
+	uint64_t carry = 0;
+	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--) {
+		uint64_t r = (uint64_t) a[i] + b[i] + carry;
+		d[i] = (uint32_t) r;
+		carry = r >> 32;
+	}
+	uint64_t borrow = 0;
+	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--) {
+		uint64_t r = (uint64_t) d[i] - M[i] - borrow;
+		d[i] = (uint32_t) r;
+		borrow = (r >> 32) & 1;
+	}
+	const uint32_t mask = (uint32_t) 0 - (uint32_t) (borrow & ~carry & 1);
+	carry = 0;
+	for (int32_t i = ((int32_t) length) - 1; i >= 0; i--) {
+		uint64_t r = (uint64_t) d[i] + (M[i] & mask) + carry;
+		d[i] = (uint32_t) r;
+		carry = r >> 32;
+	}
+}
+
+// a := X mod m->M for X of length words, by Horner's rule over chunks c of
+// m->length words from the top: a := MontProd( a, R^2 ) + MontProd( c, R ),
+// i.e. a * R + c mod M. Montgomery products and masked additions only, so
+// unlike divmod_array the time does not depend on the secret prime. c and
+// t are m->length words of scratch.
+static void crt_reduce(mont_ctx *m, uint32_t length, uint32_t *X, uint32_t *c,
+		uint32_t *t, uint32_t *a) {
+	const int32_t hlength = (int32_t) m->length;
+	const int32_t chunks = ((int32_t) length + hlength - 1) / hlength;
+	zero_array(m->length, a);
+	for (int32_t k = chunks - 1; k >= 0; k--) {
+		const int32_t first = (int32_t) length - (k + 1) * hlength;
+		for (int32_t i = 0; i < hlength; i++)
+			c[i] = (first + i >= 0) ? X[first + i] : 0;
+		mont_prod_cios_array(m->length, a, m->Nr, m->M, m->n0, t);
+		mont_prod_cios_array(m->length, c, m->Rm, m->M, m->n0, a);
+		crt_add_mod(m->length, a, t, m->M, a);
+	}
+}
+
+// Sets up the key p, q, dP = d mod (p - 1), dQ = d mod (q - 1) and
+// qInv = q ** -1 mod p, all hlength words. If E, the public exponent in
+// length words, is not NULL every result is checked by raising it back to
+// E mod N. The arguments are copied.
+mont_crt_ctx *mont_crt_ctx_new(uint32_t length, uint32_t hlength, uint32_t *p,
+		uint32_t *q, uint32_t *dP, uint32_t *dQ, uint32_t *qInv, uint32_t *E) {
+	mont_crt_ctx *ctx = calloc(1, sizeof(mont_crt_ctx));
+	if (ctx == NULL) die("calloc");
+	const uint32_t wlength = (length > 2 * hlength) ? length : 2 * hlength;
+	ctx->length = length;
+	ctx->hlength = hlength;
+	ctx->dP = crt_calloc(hlength);
+	ctx->dQ = crt_calloc(hlength);
+	ctx->qInvR = crt_calloc(hlength);
+	ctx->m1 = crt_calloc(hlength);
+	ctx->m2 = crt_calloc(hlength);
+	ctx->h = crt_calloc(hlength);
+	ctx->wide = crt_calloc(2 * hlength);
+	ctx->temp = crt_calloc(wlength);
+	ctx->check = crt_calloc(length);
+
+	ctx->p = mont_ctx_new(hlength, p);
+	ctx->q = mont_ctx_new(hlength, q);
+	copy_array(hlength, dP, ctx->dP);
+	copy_array(hlength, dQ, ctx->dQ);
+	mont_prod_cios_array(hlength, qInv, ctx->p->Nr, p, ctx->p->n0, ctx->qInvR);
+	if (E != NULL) {
+		ctx->E = crt_calloc(length);
+		copy_array(length, E, ctx->E);
+		mul_array(hlength, p, q, ctx->wide);
+		crt_resize(2 * hlength, ctx->wide, length, ctx->check);
+		ctx->n = mont_ctx_new(length, ctx->check);
+		ctx->n->mode = MONT_EXP_MODE_PUBLIC_FAST;
+	}
+	return ctx;
+}
+
+void mont_crt_ctx_free(mont_crt_ctx *ctx) {
+	if (ctx == NULL)
+		return;
+	mont_ctx_free(ctx->p);
+	mont_ctx_free(ctx->q);
+	mont_ctx_free(ctx->n);
+	free(ctx->dP);
+	free(ctx->dQ);
+	free(ctx->qInvR);
+	free(ctx->E);
+	free(ctx->m1);
+	free(ctx->m2);
+	free(ctx->h);
+	free(ctx->wide);
+	free(ctx->temp);
+	free(ctx->check);
+	free(ctx);
+}
+
+// Z := X ** d mod N for X < N:
+//   m1 := X ** dP mod p, m2 := X ** dQ mod q
+//   h  := qInv * (m1 - m2) mod p
+//   Z  := m2 + h * q
+// Returns 1, or 0 with Z zeroed if the check against the public exponent
+// fails, so that a faulty result, which gives away p, is never released.
+int mod_exp_crt_ctx(mont_crt_ctx *ctx, uint32_t *X, uint32_t *Z) {
+	const uint32_t length = ctx->length;
+	const uint32_t hlength = ctx->hlength;
+	mont_ctx *p = ctx->p;
+	mont_ctx *q = ctx->q;
+
+	crt_reduce(p, length, X, ctx->m1, ctx->wide, ctx->h);
+	mod_exp_ctx(p, ctx->h, ctx->dP, ctx->m1);
+	crt_reduce(q, length, X, ctx->m2, ctx->wide, ctx->h);
+	mod_exp_ctx(q, ctx->h, ctx->dQ, ctx->m2);
+
+	// MontProd( m2, R mod p ) is m2 mod p without a division, m2 being
+	// below R; MontProd( m1 - m2, qInv * R ) the product with qInv.
+	mont_prod_cios_array(hlength, ctx->m2, p->Rm, p->M, p->n0, ctx->h);
+	crt_sub_mod(hlength, ctx->m1, ctx->h, p->M, ctx->m1);
+	mont_prod_cios_array(hlength, ctx->m1, ctx->qInvR, p->M, p->n0, ctx->h);
+
+	mul_array(hlength, ctx->h, q->M, ctx->wide);
+	crt_resize(hlength, ctx->m2, 2 * hlength, ctx->temp);
+	add_array(2 * hlength, ctx->wide, ctx->temp, ctx->wide);
+	crt_resize(2 * hlength, ctx->wide, length, Z);
+
+	if (ctx->n != NULL) {
+		mod_exp_ctx(ctx->n, Z, ctx->E, ctx->check);
+		uint32_t diff = 0;
+		for (uint32_t i = 0; i < length; i++)
+			diff |= ctx->check[i] ^ X[i];
+		if (diff != 0) {
+			zero_array(length, Z);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// One shot mod_exp_crt_ctx; E may be NULL to skip the check.
+int mod_exp_crt_array(uint32_t length, uint32_t hlength, uint32_t *X,
+		uint32_t *p, uint32_t *q, uint32_t *dP, uint32_t *dQ, uint32_t *qInv,
+		uint32_t *E, uint32_t *Z) {
+	mont_crt_ctx *ctx = mont_crt_ctx_new(length, hlength, p, q, dP, dQ, qInv, E);
+	int ok = mod_exp_crt_ctx(ctx, X, Z);
+	mont_crt_ctx_free(ctx);
+	return ok;
+}
@@ -0,0 +1,55 @@
+/*
+ * montgomery_crt.h
+ *
+ *  RSA private key operation through the Chinese remainder theorem: two
+ *  exponentiations modulo p and q at half the length of N = p * q and a
+ *  Garner recombination, instead of one X ** d mod N at full length.
+ *  Operands are the usual big endian uint32_t arrays; N, X and Z are
+ *  length words, p, q, dP, dQ and qInv hlength words, 2 * hlength words
+ *  must hold N.
+ *
+ *  mont_crt_ctx_new finds R^2 mod p and mod q by mod_pow2_array, with
+ *  masked doublings, so the setup does not branch on the primes, but its
+ *  time still follows their bit lengths and it costs a few times one
+ *  exponentiation. Set up once per key, off the request path, and keep
+ *  the context.
+ */
+
+#ifndef MONTGOMERY_CRT_H_
+#define MONTGOMERY_CRT_H_
+
+#include <stdint.h>
+#include "montgomery_array.h"
+
+// Key state for repeated private key operations. p and q hold one mont_ctx
+// per prime, in the secret fixed window mode, and n one for N in the public
+// mode if the result is checked, NULL otherwise. qInvR is qInv * R mod p,
+// E the public exponent (length words) or NULL. The remaining buffers are
+// scratch, with the same one thread rule as mont_ctx.
+typedef struct {
+	uint32_t length;
+	uint32_t hlength;
+	mont_ctx *p;
+	mont_ctx *q;
+	mont_ctx *n;
+	uint32_t *dP;
+	uint32_t *dQ;
+	uint32_t *qInvR;
+	uint32_t *E;
+	uint32_t *m1;
+	uint32_t *m2;
+	uint32_t *h;
+	uint32_t *wide;
+	uint32_t *temp;
+	uint32_t *check;
+} mont_crt_ctx;
+
+mont_crt_ctx *mont_crt_ctx_new(uint32_t length, uint32_t hlength, uint32_t *p,
+		uint32_t *q, uint32_t *dP, uint32_t *dQ, uint32_t *qInv, uint32_t *E);
+void mont_crt_ctx_free(mont_crt_ctx *ctx);
+int mod_exp_crt_ctx(mont_crt_ctx *ctx, uint32_t *X, uint32_t *Z);
+int mod_exp_crt_array(uint32_t length, uint32_t hlength, uint32_t *X,
+		uint32_t *p, uint32_t *q, uint32_t *dP, uint32_t *dQ, uint32_t *qInv,
+		uint32_t *E, uint32_t *Z);
+
+#endif /* MONTGOMERY_CRT_H_ */
@@ -0,0 +1,50 @@
+/*
+ * montgomery_dispatch.h
+ *
+ *  Run time selection of the arithmetic kernels. The CPU is probed once,
+ *  on first use from any thread (pthread_once, link with -lpthread).
+ *  mont_ctx_new picks its backend here and mont_ctx_u64_init copies the
+ *  64 bit limb kernels into the context, so its products are direct calls.
+ *  The free functions mont_prod_u64, mont_prod_lazy_u64, mont_sqr_u64,
+ *  mont_sqr_lazy_u64 and mod_exp_array look the kernels up on every call.
+ *
+ *  add_array and sub_array are not dispatched: they are linear in the
+ *  length and run a few times per exponentiation, e.g. in the CRT
+ *  recombination, next to thousands of quadratic products.
+ *
+ *  The MONT_BACKEND environment variable limits the selection, for A/B
+ *  comparisons, to one of "uint32", "uint64", "adx" or "ifma" and the
+ *  extensions listed before it, as far as the CPU has them.
+ */
+
+#ifndef MONTGOMERY_DISPATCH_H_
+#define MONTGOMERY_DISPATCH_H_
+
+#include <stdint.h>
+
+// Feature bits, in the order the MONT_BACKEND names enable them.
+#define MONT_CPU_UINT64 1
+#define MONT_CPU_ADX    2
+#define MONT_CPU_IFMA   4
+
+// detected holds the MONT_CPU_* bits of the build and CPU, features the
+// ones in use. mont_ctx_new picks its backend from features.
+typedef struct {
+	uint32_t detected;
+	uint32_t features;
+	void (*mont_prod_u64)(uint32_t length, uint64_t *A, uint64_t *B,
+			uint64_t *M, uint64_t n0, uint64_t *s);
+	void (*mont_prod_lazy_u64)(uint32_t length, uint64_t *A, uint64_t *B,
+			uint64_t *M, uint64_t n0, uint64_t *s);
+	void (*mont_sqr_u64)(uint32_t length, uint64_t *A, uint64_t *M,
+			uint64_t n0, uint64_t *t, uint64_t *s);
+	void (*mont_sqr_lazy_u64)(uint32_t length, uint64_t *A, uint64_t *M,
+			uint64_t n0, uint64_t *t, uint64_t *s);
+	void (*mod_exp_public)(uint32_t length, uint32_t *X, uint32_t *E,
+			uint32_t *M, uint32_t *Z);
+} mont_dispatch;
+
+const mont_dispatch *mont_get_dispatch(void);
+int mont_dispatch_init(const char *backend);
+
+#endif /* MONTGOMERY_DISPATCH_H_ */
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bignum_uint32_t.h"
+#include "bignum_uint64_t.h"
+#include "montgomery_array.h"
+#include "montgomery_ifma.h"
+
+#ifdef MONT_HAVE_IFMA
+
+#include <immintrin.h>
+
+#define IFMA __attribute__((target("avx512f,avx512ifma")))
+#define KERNEL IFMA static inline __attribute__((always_inline))
+#define MASK52 ((((uint64_t) 1) << 52) - 1)
+#define LOAD(p) _mm512_loadu_si512((const void *) (p))
+#define STORE(p, v) _mm512_storeu_si512((void *) (p), (v))
+
+// Vectors of eight digits for a bits sized modulus.
+#define IFMA_VECTORS(bits) (((bits) / 52 + 8) / 8)
+
+int mont_ifma_available(void) {
+	return __builtin_cpu_supports("avx512f")
+			&& __builtin_cpu_supports("avx512ifma");
+}
+
+static uint64_t word_le32(uint32_t length, uint32_t *a, uint32_t k) {
+	return (k < length) ? a[length - 1 - k] : 0;
+}
+
+// d (size digits) := a (length words), digits past a read as zero.
+void array_to_ifma(uint32_t length, uint32_t *a, uint32_t size, uint64_t *d) {
+	for (uint32_t j = 0; j < size; j++) {
+		const uint32_t k = 52 * j / 32;
+		const uint32_t off = 52 * j % 32;
+		uint64_t v = (word_le32(length, a, k)
+				| (word_le32(length, a, k + 1) << 32)) >> off;
+		if (off > 12)
+			v |= word_le32(length, a, k + 2) << (64 - off);
+		d[j] = v & MASK52;
+	}
+}
+
+// a (length words) := d (size normalized digits).
+void ifma_to_array(uint32_t size, uint64_t *d, uint32_t length, uint32_t *a) {
+	for (uint32_t k = 0; k < length; k++) {
+		const uint32_t j = 32 * k / 52;
+		const uint32_t off = 32 * k % 52;
+		uint64_t v = (j < size) ? d[j] >> off : 0;
+		if ((off > 20) && (j + 1 < size))
+			v |= d[j + 1] << (52 - off);
+		a[length - 1 - k] = (uint32_t) v;
+	}
+}
+
+// s := s mod M for the digits of a product below 2M as left by the kernel:
+// carries are propagated, then M is subtracted under a mask, see
+// mont_final_sub_array.
+static void ifma_normalize(uint32_t n52, uint64_t *M, uint64_t *s) {
+	uint64_t carry = 0;
+	for (uint32_t j = 0; j < n52; j++) {
+		uint64_t v = s[j] + carry;
+		s[j] = v & MASK52;
+		carry = v >> 52;
+	}
+	uint64_t borrow = 0;
+	for (uint32_t j = 0; j < n52; j++)
+		borrow = (s[j] - M[j] - borrow) >> 63;
+	const uint64_t mask = borrow - 1;
+	borrow = 0;
+	for (uint32_t j = 0; j < n52; j++) {
+		uint64_t d = s[j] - (M[j] & mask) - borrow;
+		s[j] = d & MASK52;
+		borrow = d >> 63;
+	}
+}
+
+// Montgomery product s = A * B / 2^(52*n52) mod M on nv vectors of digits.
+// Per digit of B, the low halves of A * B[i] and q * M are added in place,
+// the accumulator is shifted down one digit and the high halves are added
+// at the positions they belong to after the shift. The accumulator digits
+// are left unnormalized, n52 rounds of four 52 bit terms fit in 64 bits,
+// and only the carry out of the dropped digit is moved along. s may
+// overlap A or B.
+KERNEL void mont_prod_ifma_kernel(const uint32_t nv, uint32_t n52, uint64_t *A,
+		uint64_t *B, uint64_t *M, uint64_t n0, uint64_t *s) {
+	const __m512i zero = _mm512_setzero_si512();
+	__m512i acc[MONT_IFMA_MAX_VECTORS];
+	for (uint32_t j = 0; j < nv; j++)
+		acc[j] = zero;
+	for (uint32_t i = 0; i < n52; i++) {
+		const __m512i bi = _mm512_set1_epi64((long long) B[i]);
+		for (uint32_t j = 0; j < nv; j++)
+			acc[j] = _mm512_madd52lo_epu64(acc[j], LOAD(A + 8 * j), bi);
+		const uint64_t a0 = (uint64_t) _mm_cvtsi128_si64(
+				_mm512_castsi512_si128(acc[0]));
+		const uint64_t q = (a0 * n0) & MASK52;
+		const uint64_t carry = (a0 + ((q * M[0]) & MASK52)) >> 52;
+		const __m512i qv = _mm512_set1_epi64((long long) q);
+		for (uint32_t j = 0; j < nv; j++)
+			acc[j] = _mm512_madd52lo_epu64(acc[j], LOAD(M + 8 * j), qv);
+
+		for (uint32_t j = 0; j + 1 < nv; j++)
+			acc[j] = _mm512_alignr_epi64(acc[j + 1], acc[j], 1);
+		acc[nv - 1] = _mm512_alignr_epi64(zero, acc[nv - 1], 1);
+		acc[0] = _mm512_mask_add_epi64(acc[0], 1, acc[0],
+				_mm512_set1_epi64((long long) carry));
+
+		for (uint32_t j = 0; j < nv; j++) {
+			acc[j] = _mm512_madd52hi_epu64(acc[j], LOAD(A + 8 * j), bi);
+			acc[j] = _mm512_madd52hi_epu64(acc[j], LOAD(M + 8 * j), qv);
+		}
+	}
+	for (uint32_t j = 0; j < nv; j++)
+		STORE(s + 8 * j, acc[j]);
+	ifma_normalize(n52, M, s);
+}
+
+// Fixed size instances for the 1024, 2048, 3072, 4096 and 8192 bit
+// RSA/DH sizes, see MONT_U64_FIXED.
+#define MONT_IFMA_FIXED(bits) \
+	IFMA static void mont_prod_ifma_##bits(uint32_t n52, uint64_t *A, \
+			uint64_t *B, uint64_t *M, uint64_t n0, uint64_t *s) { \
+		mont_prod_ifma_kernel(IFMA_VECTORS(bits), n52, A, B, M, n0, s); \
+	}
+
+MONT_IFMA_FIXED(1024)
+MONT_IFMA_FIXED(2048)
+MONT_IFMA_FIXED(3072)
+MONT_IFMA_FIXED(4096)
+MONT_IFMA_FIXED(8192)
+
+IFMA static void mont_prod_ifma_generic(uint32_t nv, uint32_t n52, uint64_t *A,
+		uint64_t *B, uint64_t *M, uint64_t n0, uint64_t *s) {
+	mont_prod_ifma_kernel(nv, n52, A, B, M, n0, s);
+}
+
+void mont_prod_ifma(mont_ctx_ifma *ctx, uint64_t *A, uint64_t *B, uint64_t *s) {
+	const uint32_t n52 = ctx->n52;
+	switch (ctx->size / 8) {
+	case IFMA_VECTORS(1024): mont_prod_ifma_1024(n52, A, B, ctx->M, ctx->n0, s); break;
+	case IFMA_VECTORS(2048): mont_prod_ifma_2048(n52, A, B, ctx->M, ctx->n0, s); break;
+	case IFMA_VECTORS(3072): mont_prod_ifma_3072(n52, A, B, ctx->M, ctx->n0, s); break;
+	case IFMA_VECTORS(4096): mont_prod_ifma_4096(n52, A, B, ctx->M, ctx->n0, s); break;
+	case IFMA_VECTORS(8192): mont_prod_ifma_8192(n52, A, B, ctx->M, ctx->n0, s); break;
+	default: mont_prod_ifma_generic(ctx->size / 8, n52, A, B, ctx->M, ctx->n0, s); break;
+	}
+}
+
+// The squaring shares the product loop: with both halves of every digit
+// product added by one instruction there is little left to save by
+// doubling the cross products.
+void mont_sqr_ifma(mont_ctx_ifma *ctx, uint64_t *A, uint64_t *s) {
+	mont_prod_ifma(ctx, A, A, s);
+}
+
+// s := A * B * 2^(-32*length) mod M, the same as mont_prod_array and
+// mont_prod_cios_array, through the radix 2^52 kernel: the second product
+// with C = 2^(2*52*n52 - 32*length) mod M trades R for mont_prod_array's.
+void mont_prod_ifma_array(mont_ctx_ifma *ctx, uint32_t *A, uint32_t *B,
+		uint32_t *s) {
+	array_to_ifma(ctx->length, A, ctx->size, ctx->X);
+	array_to_ifma(ctx->length, B, ctx->size, ctx->P);
+	mont_prod_ifma(ctx, ctx->X, ctx->P, ctx->T);
+	mont_prod_ifma(ctx, ctx->T, ctx->C, ctx->Z);
+	ifma_to_array(ctx->size, ctx->Z, ctx->length, s);
+}
+
+// d := 2^e mod M as size digits, by mod_pow2_array, which does not branch
+// on M.
+static void ifma_pow2_mod(uint32_t length, uint32_t *M, uint32_t e,
+		uint32_t size, uint64_t *d) {
+	uint32_t *r = calloc(2 * (size_t) length, sizeof(uint32_t));
+	if (r == NULL) die("calloc");
+	mod_pow2_array(length, M, e, r + length, r);
+	array_to_ifma(length, r, size, d);
+	free(r);
+}
+
+static uint64_t *ifma_calloc(uint32_t size) {
+	uint64_t *d = calloc(size, sizeof(uint64_t));
+	if (d == NULL) die("calloc");
+	return d;
+}
+
+// NULL where the CPU lacks IFMA or the modulus is over MONT_IFMA_MAX_BITS.
+mont_ctx_ifma *mont_ctx_ifma_new(uint32_t length, uint32_t *M) {
+	const uint32_t n52 = 32 * length / 52 + 1;
+	const uint32_t size = (n52 + 7) / 8 * 8;
+	if (!mont_ifma_available() || (size / 8 > MONT_IFMA_MAX_VECTORS))
+		return NULL;
+	mont_ctx_ifma *ctx = calloc(1, sizeof(mont_ctx_ifma));
+	if (ctx == NULL) die("calloc");
+	ctx->length = length;
+	ctx->n52 = n52;
+	ctx->size = size;
+	ctx->M = ifma_calloc(size);
+	ctx->Nr = ifma_calloc(size);
+	ctx->Rm = ifma_calloc(size);
+	ctx->C = ifma_calloc(size);
+	ctx->ONE = ifma_calloc(size);
+	ctx->X = ifma_calloc(size);
+	ctx->P = ifma_calloc(size);
+	ctx->Z = ifma_calloc(size);
+	ctx->T = ifma_calloc(size);
+	ctx->table = ifma_calloc(size << (MONT_WINDOW_MAX - 1));
+
+	array_to_ifma(length, M, size, ctx->M);
+	const uint64_t m0 = ctx->M[0];
+	uint64_t x = m0;
+	for (int i = 0; i < 5; i++)
+		x *= 2 - m0 * x;
+	ctx->n0 = (0 - x) & MASK52;
+	ifma_pow2_mod(length, M, 52 * n52, size, ctx->Rm);
+	ifma_pow2_mod(length, M, 2 * 52 * n52, size, ctx->Nr);
+	ifma_pow2_mod(length, M, 2 * 52 * n52 - 32 * length, size, ctx->C);
+	ctx->ONE[0] = 1;
+	return ctx;
+}
+
+void mont_ctx_ifma_free(mont_ctx_ifma *ctx) {
+	if (ctx == NULL)
+		return;
+	free(ctx->M);
+	free(ctx->Nr);
+	free(ctx->Rm);
+	free(ctx->C);
+	free(ctx->ONE);
+	free(ctx->X);
+	free(ctx->P);
+	free(ctx->Z);
+	free(ctx->T);
+	free(ctx->table);
+	free(ctx);
+}
+
+// dst := table[index] reading every entry, see mont_table_select_array.
+static void mont_table_select_ifma(uint32_t size, uint64_t *table,
+		uint32_t entries, uint32_t index, uint64_t *dst) {
+	zero_u64(size, dst);
+	for (uint32_t k = 0; k < entries; k++) {
+		uint64_t mask = 0 - (uint64_t) (((uint64_t) (k ^ index) - 1) >> 63);
+		for (uint32_t j = 0; j < size; j++)
+			dst[j] |= table[k * size + j] & mask;
+	}
+}
+
+// Sliding window, see mont_exp_window_loop_array.
+static void mont_exp_window_ifma(mont_ctx_ifma *ctx, uint32_t window,
+		uint32_t *E) {
+	const uint32_t length = ctx->length;
+	const uint32_t n = ctx->size;
+	uint64_t *Z = ctx->Z;
+	uint64_t *table = ctx->table;
+	const uint32_t bits = findN(length, E);
+	if (window == 0)
+		window = mont_window_bits_exp(length, E);
+
+	mont_prod_ifma(ctx, ctx->X, ctx->Nr, table);
+	if (window > 1) {
+		mont_sqr_ifma(ctx, table, ctx->P);
+		for (uint32_t k = 1; k < (1u << (window - 1)); k++)
+			mont_prod_ifma(ctx, table + (k - 1) * n, ctx->P, table + k * n);
+	}
+
+	copy_u64(n, ctx->Rm, Z);
+	uint32_t started = 0;
+	int32_t i = ((int32_t) bits) - 1;
+	while (i >= 0) {
+		if (exp_bit_array(length, E, (uint32_t) i) == 0) {
+			if (started)
+				mont_sqr_ifma(ctx, Z, Z);
+			i--;
+			continue;
+		}
+		int32_t j = i - ((int32_t) window) + 1;
+		if (j < 0)
+			j = 0;
+		while (exp_bit_array(length, E, (uint32_t) j) == 0)
+			j++;
+		uint32_t value = exp_bits_array(length, E, j, (uint32_t) (i - j + 1));
+
+		uint64_t *entry = table + (value >> 1) * n;
+		if (started) {
+			for (int32_t k = i; k >= j; k--)
+				mont_sqr_ifma(ctx, Z, Z);
+			mont_prod_ifma(ctx, Z, entry, Z);
+		} else {
+			copy_u64(n, entry, Z);
+			started = 1;
+		}
+		i = j - 1;
+	}
+}
+
+// Fixed window, see mont_exp_fixed_window_loop_array.
+static void mont_exp_fixed_window_ifma(mont_ctx_ifma *ctx, uint32_t window,
+		uint32_t *E) {
+	const uint32_t length = ctx->length;
+	const uint32_t n = ctx->size;
+	uint64_t *Z = ctx->Z;
+	uint64_t *table = ctx->table;
+	const int32_t nbits = 32 * (int32_t) length;
+	window = mont_fixed_window_bits((uint32_t) nbits, window);
+	const uint32_t entries = 1u << window;
+
+	copy_u64(n, ctx->Rm, table);
+	mont_prod_ifma(ctx, ctx->X, ctx->Nr, table + n);
+	for (uint32_t k = 2; k < entries; k++)
+		mont_prod_ifma(ctx, table + (k - 1) * n, table + n, table + k * n);
+
+	int32_t i = nbits - (int32_t) window;
+	if (nbits % (int32_t) window)
+		i = nbits - nbits % (int32_t) window;
+	mont_table_select_ifma(n, table, entries,
+			exp_bits_array(length, E, i, window), Z);
+	while (i > 0) {
+		i -= (int32_t) window;
+		for (uint32_t k = 0; k < window; k++)
+			mont_sqr_ifma(ctx, Z, Z);
+		mont_table_select_ifma(n, table, entries,
+				exp_bits_array(length, E, i, window), ctx->P);
+		mont_prod_ifma(ctx, Z, ctx->P, Z);
+	}
+}
+
+// Montgomery ladder, see mont_exp_ladder_loop_array.
+static void mont_exp_ladder_ifma(mont_ctx_ifma *ctx, uint32_t *E) {
+	const uint32_t length = ctx->length;
+	const uint32_t n = ctx->size;
+	uint64_t *Z = ctx->Z;
+	uint64_t *P = ctx->P;
+
+	copy_u64(n, ctx->Rm, Z);
+	mont_prod_ifma(ctx, ctx->X, ctx->Nr, P);
+	for (int32_t i = 32 * ((int32_t) length) - 1; i >= 0; i--) {
+		uint64_t mask = 0 - (uint64_t) exp_bit_array(length, E, (uint32_t) i);
+		cswap_u64(n, mask, Z, P);
+		mont_prod_ifma(ctx, Z, P, P);
+		mont_sqr_ifma(ctx, Z, Z);
+		cswap_u64(n, mask, Z, P);
+	}
+}
+
+// Z := X ** E mod M with mode and window as in mont_ctx. X, E and Z are
+// ctx->length word uint32_t arrays.
+void mod_exp_ifma_ctx(mont_ctx_ifma *ctx, uint32_t mode, uint32_t window,
+		uint32_t *X, uint32_t *E, uint32_t *Z) {
+	array_to_ifma(ctx->length, X, ctx->size, ctx->X);
+	switch (mode) {
+	case MONT_EXP_MODE_PUBLIC_FAST:
+		mont_exp_window_ifma(ctx, window, E);
+		break;
+	case MONT_EXP_MODE_SECRET_LADDER:
+		mont_exp_ladder_ifma(ctx, E);
+		break;
+	default:
+		mont_exp_fixed_window_ifma(ctx, window, E);
+		break;
+	}
+	mont_prod_ifma(ctx, ctx->Z, ctx->ONE, ctx->Z);
+	ifma_to_array(ctx->size, ctx->Z, ctx->length, Z);
+}
+
+#endif /* MONT_HAVE_IFMA */
@@ -0,0 +1,61 @@
+/*
+ * montgomery_ifma.h
+ *
+ *  Radix 2^52 Montgomery backend for AVX-512 IFMA (vpmadd52luq/vpmadd52huq).
+ *  Numbers are little endian arrays of 52 bit digits, least significant
+ *  digit at index 0, zero padded to a multiple of eight digits (one zmm
+ *  register). R = 2^(52*n52) with n52 = 32*length/52 + 1 digits, so that
+ *  2M < R. mont_ctx_ifma and the mod_exp entry points take and return the
+ *  usual big endian uint32_t arrays.
+ */
+
+#ifndef MONTGOMERY_IFMA_H_
+#define MONTGOMERY_IFMA_H_
+
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MONT_HAVE_IFMA 1
+#endif
+
+// Moduli up to this size, plus a leading zero word, use the IFMA backend.
+#define MONT_IFMA_MAX_BITS 8192
+#define MONT_IFMA_MAX_VECTORS ((MONT_IFMA_MAX_BITS + 32) / 52 / 8 + 1)
+
+#ifdef MONT_HAVE_IFMA
+
+// Radix 2^52 state for one modulus. n52 is the number of digits, size the
+// padded length of every buffer except table (entries * size) and C, the
+// factor that turns a radix 2^52 product into mont_prod_array's.
+typedef struct mont_ctx_ifma {
+	uint32_t length;
+	uint32_t n52;
+	uint32_t size;
+	uint64_t n0;
+	uint64_t *M;
+	uint64_t *Nr;
+	uint64_t *Rm;
+	uint64_t *C;
+	uint64_t *ONE;
+	uint64_t *X;
+	uint64_t *P;
+	uint64_t *Z;
+	uint64_t *T;
+	uint64_t *table;
+} mont_ctx_ifma;
+
+int mont_ifma_available(void);
+void array_to_ifma(uint32_t length, uint32_t *a, uint32_t size, uint64_t *d);
+void ifma_to_array(uint32_t size, uint64_t *d, uint32_t length, uint32_t *a);
+mont_ctx_ifma *mont_ctx_ifma_new(uint32_t length, uint32_t *M);
+void mont_ctx_ifma_free(mont_ctx_ifma *ctx);
+void mont_prod_ifma(mont_ctx_ifma *ctx, uint64_t *A, uint64_t *B, uint64_t *s);
+void mont_sqr_ifma(mont_ctx_ifma *ctx, uint64_t *A, uint64_t *s);
+void mont_prod_ifma_array(mont_ctx_ifma *ctx, uint32_t *A, uint32_t *B,
+		uint32_t *s);
+void mod_exp_ifma_ctx(mont_ctx_ifma *ctx, uint32_t mode, uint32_t window,
+		uint32_t *X, uint32_t *E, uint32_t *Z);
+
+#endif /* MONT_HAVE_IFMA */
+
+#endif /* MONTGOMERY_IFMA_H_ */
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "bignum_uint32_t.h"
+#include "montgomery_array.h"
+#include "montgomery_dispatch.h"
+#include "montgomery_pool.h"
+
+// Job queue and context cache of one worker. jobs[head .. tail) are
+// queued; the owner takes from the tail, thieves from the head.
+typedef struct {
+	pthread_mutex_t lock;
+	mont_job **jobs;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t size;
+	uint32_t next;
+	mont_ctx *cache[MONT_POOL_CTX_CACHE];
+} mont_worker;
+
+// queued counts jobs in the queues not yet claimed by a worker, submitted
+// and completed all jobs since mont_pool_new; lock guards the three and
+// stop.
+struct mont_pool {
+	uint32_t threads;
+	uint32_t next;
+	uint32_t queued;
+	uint32_t stop;
+	uint64_t submitted;
+	uint64_t completed;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	pthread_t *thread;
+	mont_worker *worker;
+};
+
+typedef struct {
+	mont_pool *pool;
+	uint32_t self;
+} mont_worker_arg;
+
+static void pool_check(int err, const char *what) {
+	if (err != 0) die(what);
+}
+
+static void worker_push(mont_worker *w, mont_job *job) {
+	if (w->tail == w->size) {
+		w->size = (w->size == 0) ? 64 : 2 * w->size;
+		w->jobs = realloc(w->jobs, w->size * sizeof(mont_job *));
+		if (w->jobs == NULL) die("realloc");
+	}
+	w->jobs[w->tail++] = job;
+}
+
+// Takes a job, the newest of the own queue or the oldest of the next
+// worker that has one. The caller has claimed it through pool->queued, so
+// there is one, but a thief may get there first and force another round.
+static mont_job *pool_take(mont_pool *pool, uint32_t self) {
+	for (;;) {
+		for (uint32_t k = 0; k < pool->threads; k++) {
+			mont_worker *w = &pool->worker[(self + k) % pool->threads];
+			mont_job *job = NULL;
+			pthread_mutex_lock(&w->lock);
+			if (w->head != w->tail)
+				job = (k == 0) ? w->jobs[--w->tail] : w->jobs[w->head++];
+			if (w->head == w->tail)
+				w->head = w->tail = 0;
+			pthread_mutex_unlock(&w->lock);
+			if (job != NULL)
+				return job;
+		}
+	}
+}
+
+// The worker's mont_ctx for job->M, made in place of the oldest one if
+// it is not cached.
+static mont_ctx *worker_ctx(mont_worker *w, mont_job *job) {
+	for (uint32_t k = 0; k < MONT_POOL_CTX_CACHE; k++) {
+		mont_ctx *ctx = w->cache[k];
+		if ((ctx != NULL) && (ctx->length == job->length)
+				&& (memcmp(ctx->M, job->M, job->length * sizeof(uint32_t)) == 0))
+			return ctx;
+	}
+	mont_ctx_free(w->cache[w->next]);
+	mont_ctx *ctx = mont_ctx_new(job->length, job->M);
+	w->cache[w->next] = ctx;
+	w->next = (w->next + 1) % MONT_POOL_CTX_CACHE;
+	return ctx;
+}
+
+static void *worker_main(void *argument) {
+	mont_worker_arg *arg = argument;
+	mont_pool *pool = arg->pool;
+	mont_worker *w = &pool->worker[arg->self];
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		while ((pool->queued == 0) && !pool->stop)
+			pthread_cond_wait(&pool->work, &pool->lock);
+		if (pool->queued == 0) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		pool->queued--;
+		pthread_mutex_unlock(&pool->lock);
+
+		mont_job *job = pool_take(pool, arg->self);
+		mont_ctx *ctx = worker_ctx(w, job);
+		ctx->mode = job->mode;
+		mod_exp_ctx(ctx, job->X, job->E, job->Z);
+		if (job->done != NULL)
+			job->done(job);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->completed++;
+		if (pool->completed == pool->submitted)
+			pthread_cond_broadcast(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	for (uint32_t k = 0; k < MONT_POOL_CTX_CACHE; k++)
+		mont_ctx_free(w->cache[k]);
+	free(arg);
+	return NULL;
+}
+
+// Starts threads workers, or one per online CPU for 0.
+mont_pool *mont_pool_new(uint32_t threads) {
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? (uint32_t) cpus : 1;
+	}
+	mont_pool *pool = calloc(1, sizeof(mont_pool));
+	if (pool == NULL) die("calloc");
+	pool->threads = threads;
+	pool->thread = calloc(threads, sizeof(pthread_t));
+	pool->worker = calloc(threads, sizeof(mont_worker));
+	if (pool->thread == NULL) die("calloc");
+	if (pool->worker == NULL) die("calloc");
+	pool_check(pthread_mutex_init(&pool->lock, NULL), "pthread_mutex_init");
+	pool_check(pthread_cond_init(&pool->work, NULL), "pthread_cond_init");
+	pool_check(pthread_cond_init(&pool->done, NULL), "pthread_cond_init");
+
+	for (uint32_t k = 0; k < threads; k++) {
+		pool_check(pthread_mutex_init(&pool->worker[k].lock, NULL),
+				"pthread_mutex_init");
+		mont_worker_arg *arg = calloc(1, sizeof(mont_worker_arg));
+		if (arg == NULL) die("calloc");
+		arg->pool = pool;
+		arg->self = k;
+		pool_check(pthread_create(&pool->thread[k], NULL, worker_main, arg),
+				"pthread_create");
+	}
+	return pool;
+}
+
+// Runs the jobs still queued, then stops the workers.
+void mont_pool_free(mont_pool *pool) {
+	if (pool == NULL)
+		return;
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	for (uint32_t k = 0; k < pool->threads; k++) {
+		pthread_join(pool->thread[k], NULL);
+		pthread_mutex_destroy(&pool->worker[k].lock);
+		free(pool->worker[k].jobs);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->work);
+	pthread_cond_destroy(&pool->done);
+	free(pool->thread);
+	free(pool->worker);
+	free(pool);
+}
+
+uint32_t mont_pool_threads(mont_pool *pool) {
+	return pool->threads;
+}
+
+// Queues the jobs, dealt out to the workers in turn, and returns. The jobs
+// and their buffers must stay valid until they are done, see
+// mont_pool_wait and mont_job.done. Submitting from several threads at
+// once is not supported.
+void mont_pool_submit(mont_pool *pool, uint32_t count, mont_job *jobs) {
+	for (uint32_t k = 0; k < count; k++) {
+		mont_worker *w = &pool->worker[pool->next];
+		pool->next = (pool->next + 1) % pool->threads;
+		pthread_mutex_lock(&w->lock);
+		worker_push(w, &jobs[k]);
+		pthread_mutex_unlock(&w->lock);
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->queued += count;
+	pool->submitted += count;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// Number of jobs done since mont_pool_new.
+uint64_t mont_pool_completed(mont_pool *pool) {
+	pthread_mutex_lock(&pool->lock);
+	uint64_t completed = pool->completed;
+	pthread_mutex_unlock(&pool->lock);
+	return completed;
+}
+
+// Blocks until every job submitted so far is done.
+void mont_pool_wait(mont_pool *pool) {
+	pthread_mutex_lock(&pool->lock);
+	while (pool->completed != pool->submitted)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// mont_pool_submit and mont_pool_wait.
+void mod_exp_pool(mont_pool *pool, uint32_t count, mont_job *jobs) {
+	mont_pool_submit(pool, count, jobs);
+	mont_pool_wait(pool);
+}
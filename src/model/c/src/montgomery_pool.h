@@ -0,0 +1,44 @@
+/*
+ * montgomery_pool.h
+ *
+ *  Multi-threaded executor for independent exponentiations of mixed
+ *  sizes. Jobs are spread over the worker threads' queues; a worker runs
+ *  its own queue newest first and, once it is empty, steals the oldest
+ *  jobs of the others. Every worker keeps its own mont_ctx for the last
+ *  few moduli it saw, so jobs sharing a modulus skip the setup.
+ *  Needs POSIX threads, link with -lpthread.
+ */
+
+#ifndef MONTGOMERY_POOL_H_
+#define MONTGOMERY_POOL_H_
+
+#include <stdint.h>
+
+// mont_ctx kept per worker.
+#define MONT_POOL_CTX_CACHE 4
+
+// Z := X ** E mod M, all length words, in mode (MONT_EXP_MODE_*, 0 is the
+// secret default). done, if set, is called with the job from the worker
+// thread once Z is written; arg is left to it.
+typedef struct mont_job {
+	uint32_t length;
+	uint32_t mode;
+	uint32_t *X;
+	uint32_t *E;
+	uint32_t *M;
+	uint32_t *Z;
+	void (*done)(struct mont_job *job);
+	void *arg;
+} mont_job;
+
+typedef struct mont_pool mont_pool;
+
+mont_pool *mont_pool_new(uint32_t threads);
+void mont_pool_free(mont_pool *pool);
+uint32_t mont_pool_threads(mont_pool *pool);
+void mont_pool_submit(mont_pool *pool, uint32_t count, mont_job *jobs);
+uint64_t mont_pool_completed(mont_pool *pool);
+void mont_pool_wait(mont_pool *pool);
+void mod_exp_pool(mont_pool *pool, uint32_t count, mont_job *jobs);
+
+#endif /* MONTGOMERY_POOL_H_ */
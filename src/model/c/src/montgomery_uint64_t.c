@@ -0,0 +1,779 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bignum_uint32_t.h"
+#include "montgomery_array.h"
+#include "montgomery_uint64_t.h"
+#include "montgomery_adx.h"
+#include "montgomery_dispatch.h"
+
+#ifdef MONT_HAVE_UINT64
+
+// -M^-1 mod 2^64, see mont_n0_array. Only the low limb M[0] is read,
+// length is kept for symmetry with mont_n0_array.
+uint64_t mont_n0_u64(uint32_t length, uint64_t *M) {
+	(void) length;
+	uint64_t m0 = M[0];
+	uint64_t x = m0;
+	for (int i = 0; i < 5; i++)
+		x *= 2 - m0 * x;
+	return 0 - x;
+}
+
+// s := s - M if top:s >= M, else s, without branching on the values.
+static void mont_final_sub_u64(uint32_t length, uint64_t top, uint64_t *M,
+		uint64_t *s) {
+	uint128_t carry = 1;
+	for (uint32_t i = 0; i < length; i++)
+		carry = (carry + s[i] + (uint64_t) ~M[i]) >> 64;
+	uint64_t mask = 0 - (top | (uint64_t) carry);
+	carry = 1;
+	for (uint32_t i = 0; i < length; i++) {
+		uint128_t r = carry + s[i] + (uint64_t) ~(M[i] & mask);
+		s[i] = (uint64_t) r;
+		carry = r >> 64;
+	}
+}
+
+// The product, squaring and wide REDC kernels are always inlined so that
+// the fixed size instances below get a constant length, letting the
+// compiler unroll and schedule the inner loops for that size.
+#define KERNEL static inline __attribute__((always_inline))
+
+// CIOS Montgomery product, see mont_prod_cios_array. lazy skips the final
+// subtraction: for A, B < 2M and 4M < R, s < 2M and top ends up 0.
+KERNEL void mont_prod_u64_kernel(const uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s, const int lazy) {
+	uint64_t top = 0;
+	zero_u64(length, s);
+	for (uint32_t i = 0; i < length; i++) {
+		uint128_t bi = B[i];
+		uint128_t carry = 0;
+		for (uint32_t j = 0; j < length; j++) {
+			uint128_t r = A[j] * bi + s[j] + carry;
+			s[j] = (uint64_t) r;
+			carry = r >> 64;
+		}
+		uint128_t r = top + carry;
+		uint64_t t_n = (uint64_t) r;
+		uint64_t t_n1 = (uint64_t) (r >> 64);
+
+		uint128_t q = s[0] * n0;
+		r = q * M[0] + s[0];
+		carry = r >> 64;
+		for (uint32_t j = 1; j < length; j++) {
+			r = q * M[j] + s[j] + carry;
+			s[j - 1] = (uint64_t) r;
+			carry = r >> 64;
+		}
+		r = t_n + carry;
+		s[length - 1] = (uint64_t) r;
+		top = t_n1 + (uint64_t) (r >> 64);
+	}
+	if (!lazy)
+		mont_final_sub_u64(length, top, M, s);
+}
+
+// In place REDC, see mont_redc_array.
+void mont_redc_u64(uint32_t length, uint64_t *M, uint64_t n0, uint64_t *s) {
+	uint64_t top = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		uint128_t q = s[0] * n0;
+		uint128_t r = q * M[0] + s[0];
+		uint128_t carry = r >> 64;
+		for (uint32_t j = 1; j < length; j++) {
+			r = q * M[j] + s[j] + carry;
+			s[j - 1] = (uint64_t) r;
+			carry = r >> 64;
+		}
+		r = top + carry;
+		s[length - 1] = (uint64_t) r;
+		top = (uint64_t) (r >> 64);
+	}
+	mont_final_sub_u64(length, top, M, s);
+}
+
+// REDC of a 2*length limb t, see mont_redc_wide_array. lazy skips the
+// final subtraction, leaving s < 2M, for t < M * R.
+KERNEL void mont_redc_wide_u64_kernel(const uint32_t length, uint64_t *M,
+		uint64_t n0, uint64_t *t, uint64_t *s, const int lazy) {
+	uint128_t carry2 = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		uint128_t q = t[i] * n0;
+		uint128_t carry = 0;
+		for (uint32_t j = 0; j < length; j++) {
+			uint128_t r = q * M[j] + t[i + j] + carry;
+			t[i + j] = (uint64_t) r;
+			carry = r >> 64;
+		}
+		uint128_t r = t[i + length] + carry + carry2;
+		t[i + length] = (uint64_t) r;
+		carry2 = r >> 64;
+	}
+	copy_u64(length, t + length, s);
+	if (!lazy)
+		mont_final_sub_u64(length, (uint64_t) carry2, M, s);
+}
+
+// Montgomery squaring, see mont_sqr_array, lazy as for the REDC.
+KERNEL void mont_sqr_u64_kernel(const uint32_t length, uint64_t *A, uint64_t *M,
+		uint64_t n0, uint64_t *t, uint64_t *s, const int lazy) {
+	zero_u64(2 * length, t);
+
+	for (uint32_t i = 0; i + 1 < length; i++) {
+		uint128_t ai = A[i];
+		uint128_t carry = 0;
+		for (uint32_t j = i + 1; j < length; j++) {
+			uint128_t r = ai * A[j] + t[i + j] + carry;
+			t[i + j] = (uint64_t) r;
+			carry = r >> 64;
+		}
+		t[i + length] = (uint64_t) carry;
+	}
+
+	uint64_t prev = 0;
+	for (uint32_t k = 0; k < 2 * length; k++) {
+		uint64_t tk = t[k];
+		t[k] = (tk << 1) | prev;
+		prev = tk >> 63;
+	}
+	uint128_t carry = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		uint128_t sq = (uint128_t) A[i] * A[i];
+		uint128_t r = t[2 * i] + (uint128_t) (uint64_t) sq + carry;
+		t[2 * i] = (uint64_t) r;
+		r = t[2 * i + 1] + (sq >> 64) + (r >> 64);
+		t[2 * i + 1] = (uint64_t) r;
+		carry = r >> 64;
+	}
+
+	mont_redc_wide_u64_kernel(length, M, n0, t, s, lazy);
+}
+
+// Fixed size instances for the 1024, 2048, 3072, 4096 and 8192 bit
+// RSA/DH sizes, and the dispatch from the runtime length to them.
+#define MONT_U64_FIXED(bits) \
+	static void mont_prod_u64_##bits(uint64_t *A, uint64_t *B, uint64_t *M, \
+			uint64_t n0, uint64_t *s) { \
+		mont_prod_u64_kernel(bits / 64, A, B, M, n0, s, 0); \
+	} \
+	static void mont_prod_lazy_u64_##bits(uint64_t *A, uint64_t *B, \
+			uint64_t *M, uint64_t n0, uint64_t *s) { \
+		mont_prod_u64_kernel(bits / 64, A, B, M, n0, s, 1); \
+	} \
+	static void mont_sqr_u64_##bits(uint64_t *A, uint64_t *M, uint64_t n0, \
+			uint64_t *t, uint64_t *s) { \
+		mont_sqr_u64_kernel(bits / 64, A, M, n0, t, s, 0); \
+	} \
+	static void mont_sqr_lazy_u64_##bits(uint64_t *A, uint64_t *M, uint64_t n0, \
+			uint64_t *t, uint64_t *s) { \
+		mont_sqr_u64_kernel(bits / 64, A, M, n0, t, s, 1); \
+	}
+
+MONT_U64_FIXED(1024)
+MONT_U64_FIXED(2048)
+MONT_U64_FIXED(3072)
+MONT_U64_FIXED(4096)
+MONT_U64_FIXED(8192)
+
+void mont_prod_u64_portable(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s) {
+	switch (length) {
+	case 1024 / 64: mont_prod_u64_1024(A, B, M, n0, s); break;
+	case 2048 / 64: mont_prod_u64_2048(A, B, M, n0, s); break;
+	case 3072 / 64: mont_prod_u64_3072(A, B, M, n0, s); break;
+	case 4096 / 64: mont_prod_u64_4096(A, B, M, n0, s); break;
+	case 8192 / 64: mont_prod_u64_8192(A, B, M, n0, s); break;
+	default: mont_prod_u64_kernel(length, A, B, M, n0, s, 0); break;
+	}
+}
+
+// mont_prod_u64_portable without the final subtraction: for A, B < 2M and
+// 4M < R, s < 2M.
+void mont_prod_lazy_u64_portable(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s) {
+	switch (length) {
+	case 1024 / 64: mont_prod_lazy_u64_1024(A, B, M, n0, s); break;
+	case 2048 / 64: mont_prod_lazy_u64_2048(A, B, M, n0, s); break;
+	case 3072 / 64: mont_prod_lazy_u64_3072(A, B, M, n0, s); break;
+	case 4096 / 64: mont_prod_lazy_u64_4096(A, B, M, n0, s); break;
+	case 8192 / 64: mont_prod_lazy_u64_8192(A, B, M, n0, s); break;
+	default: mont_prod_u64_kernel(length, A, B, M, n0, s, 1); break;
+	}
+}
+
+#ifdef MONT_HAVE_ADX
+// mont_prod_adx up to its size limit, the portable kernel above it.
+void mont_prod_u64_adx(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+		uint64_t n0, uint64_t *s) {
+	if (length <= MONT_ADX_MAX_LIMBS)
+		mont_prod_adx(length, A, B, M, n0, s);
+	else
+		mont_prod_u64_portable(length, A, B, M, n0, s);
+}
+
+void mont_prod_lazy_u64_adx(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s) {
+	if (length <= MONT_ADX_MAX_LIMBS)
+		mont_prod_adx_lazy(length, A, B, M, n0, s);
+	else
+		mont_prod_lazy_u64_portable(length, A, B, M, n0, s);
+}
+#endif
+
+void mont_sqr_u64_portable(uint32_t length, uint64_t *A, uint64_t *M,
+		uint64_t n0, uint64_t *t, uint64_t *s) {
+	switch (length) {
+	case 1024 / 64: mont_sqr_u64_1024(A, M, n0, t, s); break;
+	case 2048 / 64: mont_sqr_u64_2048(A, M, n0, t, s); break;
+	case 3072 / 64: mont_sqr_u64_3072(A, M, n0, t, s); break;
+	case 4096 / 64: mont_sqr_u64_4096(A, M, n0, t, s); break;
+	case 8192 / 64: mont_sqr_u64_8192(A, M, n0, t, s); break;
+	default: mont_sqr_u64_kernel(length, A, M, n0, t, s, 0); break;
+	}
+}
+
+// mont_sqr_u64_portable without the final subtraction: for A < 2M and
+// 4M < R, s < 2M.
+void mont_sqr_lazy_u64_portable(uint32_t length, uint64_t *A, uint64_t *M,
+		uint64_t n0, uint64_t *t, uint64_t *s) {
+	switch (length) {
+	case 1024 / 64: mont_sqr_lazy_u64_1024(A, M, n0, t, s); break;
+	case 2048 / 64: mont_sqr_lazy_u64_2048(A, M, n0, t, s); break;
+	case 3072 / 64: mont_sqr_lazy_u64_3072(A, M, n0, t, s); break;
+	case 4096 / 64: mont_sqr_lazy_u64_4096(A, M, n0, t, s); break;
+	case 8192 / 64: mont_sqr_lazy_u64_8192(A, M, n0, t, s); break;
+	default: mont_sqr_u64_kernel(length, A, M, n0, t, s, 1); break;
+	}
+}
+
+// The kernels picked by montgomery_dispatch, looked up on every call. The
+// drivers below call the ones copied into mont_ctx_u64 instead.
+void mont_prod_u64(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+		uint64_t n0, uint64_t *s) {
+	mont_get_dispatch()->mont_prod_u64(length, A, B, M, n0, s);
+}
+
+void mont_prod_lazy_u64(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s) {
+	mont_get_dispatch()->mont_prod_lazy_u64(length, A, B, M, n0, s);
+}
+
+void mont_sqr_u64(uint32_t length, uint64_t *A, uint64_t *M, uint64_t n0,
+		uint64_t *t, uint64_t *s) {
+	mont_get_dispatch()->mont_sqr_u64(length, A, M, n0, t, s);
+}
+
+void mont_sqr_lazy_u64(uint32_t length, uint64_t *A, uint64_t *M, uint64_t n0,
+		uint64_t *t, uint64_t *s) {
+	mont_get_dispatch()->mont_sqr_lazy_u64(length, A, M, n0, t, s);
+}
+
+void mont_redc_wide_u64(uint32_t length, uint64_t *M, uint64_t n0, uint64_t *t,
+		uint64_t *s) {
+	mont_redc_wide_u64_kernel(length, M, n0, t, s, 0);
+}
+
+// mont_redc_wide_u64 without the final subtraction, s < 2M for t < M * R.
+void mont_redc_wide_lazy_u64(uint32_t length, uint64_t *M, uint64_t n0,
+		uint64_t *t, uint64_t *s) {
+	mont_redc_wide_u64_kernel(length, M, n0, t, s, 1);
+}
+
+// Non interleaved Montgomery product s = A * B / R mod M: the full product
+// by mul_karatsuba_u64, then mont_redc_wide_u64. t holds 2*length limbs, w
+// mul_karatsuba_u64_scratch(length). s may overlap A or B.
+void mont_prod_karatsuba_u64(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *t, uint64_t *w, uint64_t *s) {
+	mul_karatsuba_u64(length, A, B, t, w);
+	mont_redc_wide_u64(length, M, n0, t, s);
+}
+
+void mont_sqr_karatsuba_u64(uint32_t length, uint64_t *A, uint64_t *M,
+		uint64_t n0, uint64_t *t, uint64_t *w, uint64_t *s) {
+	sqr_karatsuba_u64(length, A, t, w);
+	mont_redc_wide_u64(length, M, n0, t, s);
+}
+
+// r (length64 limbs) := 2^(64*shift64) * a mod M, one divmod_array.
+static void mod_shift_u64(uint32_t alength, uint32_t *a, uint32_t shift64,
+		uint32_t length, uint32_t *M, uint32_t length64, uint64_t *r) {
+	const uint32_t wide = alength + 2 * shift64;
+	uint32_t *num = calloc(wide, sizeof(uint32_t));
+	uint32_t *temp = calloc(wide, sizeof(uint32_t));
+	uint32_t *rem = calloc(length, sizeof(uint32_t));
+	if (num == NULL) die("calloc");
+	if (temp == NULL) die("calloc");
+	if (rem == NULL) die("calloc");
+	copy_array(alength, a, num);
+	divmod_array(wide, num, length, M, NULL, rem, temp);
+	array_to_u64(length, rem, length64, r);
+	free(num);
+	free(temp);
+	free(rem);
+}
+
+// Limbs of the buffer mont_ctx_u64_init lays the state out in.
+size_t mont_ctx_u64_words(uint32_t length) {
+	const uint32_t n = U64_LENGTH(length);
+	return 11 * (size_t) n + ((size_t) n << (MONT_WINDOW_MAX - 1))
+			+ mul_karatsuba_u64_scratch(n) + 1;
+}
+
+// Sets up ctx for M in buf, mont_ctx_u64_words(length) limbs, without
+// allocating, with the kernels montgomery_dispatch has bound at this
+// point. temp is scratch of 2*length words.
+void mont_ctx_u64_init(mont_ctx_u64 *ctx, uint32_t length, uint32_t *M,
+		uint64_t *buf, uint32_t *temp) {
+	const uint32_t n = U64_LENGTH(length);
+	ctx->length = n;
+	ctx->M = buf;
+	ctx->Nr = ctx->M + n;
+	ctx->Rm = ctx->Nr + n;
+	ctx->X = ctx->Rm + n;
+	ctx->E = ctx->X + n;
+	ctx->P = ctx->E + n;
+	ctx->Z = ctx->P + n;
+	ctx->temp2 = ctx->Z + n;
+	ctx->wide = ctx->temp2 + 2 * n;
+	ctx->table = ctx->wide + 2 * n;
+	ctx->kara = ctx->table + ((size_t) n << (MONT_WINDOW_MAX - 1));
+
+	const mont_dispatch *d = mont_get_dispatch();
+	ctx->prod = d->mont_prod_u64;
+	ctx->prod_lazy = d->mont_prod_lazy_u64;
+	ctx->sqr = d->mont_sqr_u64;
+	ctx->sqr_lazy = d->mont_sqr_lazy_u64;
+	ctx->karatsuba = n >= MONT_KARATSUBA_LIMBS;
+	array_to_u64(length, M, n, ctx->M);
+	ctx->n0 = mont_n0_u64(n, ctx->M);
+	// Almost Montgomery reduction wherever M leaves the 4M < R headroom.
+	ctx->lazy = (ctx->M[n - 1] >> 62) == 0;
+
+	// Nr := 2^(128*n) mod M, Rm := REDC( Nr ) = 2^(64*n) mod M
+	m_residue_2_2N_fast_array(length, 64 * n, M, temp, temp + length);
+	array_to_u64(length, temp + length, n, ctx->Nr);
+	copy_u64(n, ctx->Nr, ctx->Rm);
+	mont_redc_u64(n, ctx->M, ctx->n0, ctx->Rm);
+}
+
+mont_ctx_u64 *mont_ctx_u64_new(uint32_t length, uint32_t *M) {
+	mont_ctx_u64 *ctx = calloc(1, sizeof(mont_ctx_u64)
+			+ mont_ctx_u64_words(length) * sizeof(uint64_t));
+	uint32_t *temp = calloc(2 * length, sizeof(uint32_t));
+	if (ctx == NULL) die("calloc");
+	if (temp == NULL) die("calloc");
+	mont_ctx_u64_init(ctx, length, M, (uint64_t *) (ctx + 1), temp);
+	free(temp);
+	return ctx;
+}
+
+void mont_ctx_u64_free(mont_ctx_u64 *ctx) {
+	free(ctx);
+}
+
+// Montgomery product and squaring for the drivers below: the interleaved
+// kernels, or from MONT_KARATSUBA_LIMBS the separate Karatsuba product and
+// REDC through ctx->wide. Same overlap rules as mont_prod_u64 and
+// mont_sqr_u64. With ctx->lazy, inputs and results are below 2M instead
+// of M; the drivers end with a REDC or mont_final_sub_u64.
+static void mont_prod_ctx_u64(mont_ctx_u64 *ctx, uint64_t *A, uint64_t *B,
+		uint64_t *s) {
+	const uint32_t n = ctx->length;
+	if (ctx->karatsuba) {
+		mul_karatsuba_u64(n, A, B, ctx->wide, ctx->kara);
+		if (ctx->lazy)
+			mont_redc_wide_lazy_u64(n, ctx->M, ctx->n0, ctx->wide, s);
+		else
+			mont_redc_wide_u64(n, ctx->M, ctx->n0, ctx->wide, s);
+	} else if (ctx->lazy) {
+		ctx->prod_lazy(n, A, B, ctx->M, ctx->n0, s);
+	} else {
+		ctx->prod(n, A, B, ctx->M, ctx->n0, s);
+	}
+}
+
+static void mont_sqr_ctx_u64(mont_ctx_u64 *ctx, uint64_t *A, uint64_t *s) {
+	const uint32_t n = ctx->length;
+	if (ctx->karatsuba) {
+		sqr_karatsuba_u64(n, A, ctx->wide, ctx->kara);
+		if (ctx->lazy)
+			mont_redc_wide_lazy_u64(n, ctx->M, ctx->n0, ctx->wide, s);
+		else
+			mont_redc_wide_u64(n, ctx->M, ctx->n0, ctx->wide, s);
+	} else if (ctx->lazy) {
+		ctx->sqr_lazy(n, A, ctx->M, ctx->n0, ctx->temp2, s);
+	} else {
+		ctx->sqr(n, A, ctx->M, ctx->n0, ctx->temp2, s);
+	}
+}
+
+// The loops below multiply Z back and forth between ctx->Z and ctx->P
+// instead of copying every product; this leaves the result in ctx->Z.
+static void mont_swap_zp_u64(mont_ctx_u64 *ctx, uint64_t *Z) {
+	if (Z != ctx->Z) {
+		ctx->P = ctx->Z;
+		ctx->Z = Z;
+	}
+}
+
+// dst := table[index] reading every entry, see mont_table_select_array.
+void mont_table_select_u64(uint32_t length, uint64_t *table,
+		uint32_t entries, uint32_t index, uint64_t *dst) {
+	zero_u64(length, dst);
+	for (uint32_t k = 0; k < entries; k++) {
+		uint64_t mask = 0 - (uint64_t) (((uint64_t) (k ^ index) - 1) >> 63);
+		for (uint32_t j = 0; j < length; j++)
+			dst[j] |= table[k * length + j] & mask;
+	}
+}
+
+// The width bits of the length limb E starting at bit lo, as
+// exp_bits_array, read from at most two limbs.
+static uint32_t exp_bits_u64(uint32_t length, uint64_t *E, uint32_t lo,
+		uint32_t width) {
+	const uint32_t k = lo / 64;
+	const uint32_t shift = lo % 64;
+	if (k >= length)
+		return 0;
+	uint64_t value = E[k] >> shift;
+	if ((shift + width > 64) && (k + 1 < length))
+		value |= E[k + 1] << (64 - shift);
+	return (uint32_t) (value & ((1u << width) - 1));
+}
+
+// mont_window_bits_exp for the length limb E.
+static uint32_t mont_window_bits_u64(uint32_t length, uint64_t *E) {
+	const uint32_t bits = bits_u64(length, E);
+	const uint32_t w = mont_window_bits(bits);
+	uint32_t weight = 0;
+	for (uint32_t k = 0; k < length; k++)
+		weight += (uint32_t) __builtin_popcountll(E[k]);
+	if (weight * (w + 1) <= bits)
+		return 1;
+	return w;
+}
+
+// Sliding window, see mont_exp_window_loop_array. X and E are ctx->length
+// limbs; X is brought into the Montgomery domain as MontProd( X, Nr ), Nr
+// is ctx->Nr, or ctx->Rm for an X already in it. So for the loops below.
+static void mont_exp_window_u64(mont_ctx_u64 *ctx, uint32_t window,
+		uint64_t *X, uint64_t *Nr, uint64_t *E) {
+	const uint32_t n = ctx->length;
+	uint64_t *Z = ctx->Z;
+	uint64_t *table = ctx->table;
+	const uint32_t bits = bits_u64(n, E);
+	if (window == 0)
+		window = mont_window_bits_u64(n, E);
+
+	mont_prod_ctx_u64(ctx, X, Nr, table);
+	if (window > 1) {
+		mont_sqr_ctx_u64(ctx, table, ctx->P);
+		for (uint32_t k = 1; k < (1u << (window - 1)); k++)
+			mont_prod_ctx_u64(ctx, table + (k - 1) * n, ctx->P, table + k * n);
+	}
+
+	copy_u64(n, ctx->Rm, Z);
+	uint32_t started = 0;
+	int32_t i = ((int32_t) bits) - 1;
+	while (i >= 0) {
+		if (bit_u64(n, E, (uint32_t) i) == 0) {
+			if (started)
+				mont_sqr_ctx_u64(ctx, Z, Z);
+			i--;
+			continue;
+		}
+		int32_t j = i - ((int32_t) window) + 1;
+		if (j < 0)
+			j = 0;
+		while (bit_u64(n, E, (uint32_t) j) == 0)
+			j++;
+		uint32_t value = exp_bits_u64(n, E, (uint32_t) j, (uint32_t) (i - j + 1));
+
+		uint64_t *entry = table + (value >> 1) * n;
+		if (started) {
+			for (int32_t k = i; k >= j; k--)
+				mont_sqr_ctx_u64(ctx, Z, Z);
+			uint64_t *next = (Z == ctx->Z) ? ctx->P : ctx->Z;
+			mont_prod_ctx_u64(ctx, Z, entry, next);
+			Z = next;
+		} else {
+			copy_u64(n, entry, Z);
+			started = 1;
+		}
+		i = j - 1;
+	}
+	mont_swap_zp_u64(ctx, Z);
+}
+
+// Fixed window, see mont_exp_fixed_window_loop_array, over the low nbits
+// bits of E.
+static void mont_exp_fixed_window_u64(mont_ctx_u64 *ctx, uint32_t window,
+		uint32_t nbits, uint64_t *X, uint64_t *Nr, uint64_t *E) {
+	const uint32_t n = ctx->length;
+	uint64_t *Z = ctx->Z;
+	uint64_t *table = ctx->table;
+	window = mont_fixed_window_bits(nbits, window);
+	const uint32_t entries = 1u << window;
+
+	copy_u64(n, ctx->Rm, table);
+	mont_prod_ctx_u64(ctx, X, Nr, table + n);
+	for (uint32_t k = 2; k < entries; k++)
+		mont_prod_ctx_u64(ctx, table + (k - 1) * n, table + n, table + k * n);
+
+	uint32_t i = nbits - window;
+	if (nbits % window)
+		i = nbits - nbits % window;
+	mont_table_select_u64(n, table, entries, exp_bits_u64(n, E, i, window), Z);
+	while (i > 0) {
+		i -= window;
+		for (uint32_t k = 0; k < window; k++)
+			mont_sqr_ctx_u64(ctx, Z, Z);
+		// temp2 is free between the squarings.
+		mont_table_select_u64(n, table, entries, exp_bits_u64(n, E, i, window),
+				ctx->temp2 + n);
+		uint64_t *next = (Z == ctx->Z) ? ctx->P : ctx->Z;
+		mont_prod_ctx_u64(ctx, Z, ctx->temp2 + n, next);
+		Z = next;
+	}
+	mont_swap_zp_u64(ctx, Z);
+}
+
+// Montgomery ladder, see mont_exp_ladder_loop_array, over the low nbits
+// bits of E. P takes turns with the unused table.
+static void mont_exp_ladder_u64(mont_ctx_u64 *ctx, uint32_t nbits, uint64_t *X,
+		uint64_t *Nr, uint64_t *E) {
+	const uint32_t n = ctx->length;
+	uint64_t *Z = ctx->Z;
+	uint64_t *P = ctx->P;
+	uint64_t *spare = ctx->table;
+	uint64_t *t;
+
+	copy_u64(n, ctx->Rm, Z);
+	mont_prod_ctx_u64(ctx, X, Nr, P);
+	for (int32_t i = ((int32_t) nbits) - 1; i >= 0; i--) {
+		uint64_t mask = 0 - bit_u64(n, E, (uint32_t) i);
+		cswap_u64(n, mask, Z, P);
+		mont_prod_ctx_u64(ctx, Z, P, spare);
+		t = P; P = spare; spare = t;
+		mont_sqr_ctx_u64(ctx, Z, Z);
+		cswap_u64(n, mask, Z, P);
+	}
+}
+
+// ctx->Z := MontProd( X, Nr ) ** E in the Montgomery domain, the secret
+// modes over the low nbits bits of E.
+static void mont_exp_u64(mont_ctx_u64 *ctx, uint32_t mode, uint32_t window,
+		uint32_t nbits, uint64_t *X, uint64_t *Nr, uint64_t *E) {
+	switch (mode) {
+	case MONT_EXP_MODE_PUBLIC_FAST:
+		mont_exp_window_u64(ctx, window, X, Nr, E);
+		break;
+	case MONT_EXP_MODE_SECRET_LADDER:
+		mont_exp_ladder_u64(ctx, nbits, X, Nr, E);
+		break;
+	default:
+		mont_exp_fixed_window_u64(ctx, window, nbits, X, Nr, E);
+		break;
+	}
+}
+
+// Z := X ** E mod M with mode and window as in mont_ctx. X, E and Z are
+// length word uint32_t arrays, converted once on the way in and out.
+void mod_exp_u64_ctx(mont_ctx_u64 *ctx, uint32_t mode, uint32_t window,
+		uint32_t length, uint32_t *X, uint32_t *E, uint32_t *Z) {
+	array_to_u64(length, X, ctx->length, ctx->X);
+	array_to_u64(length, E, ctx->length, ctx->E);
+	mont_exp_u64(ctx, mode, window, 32 * length, ctx->X, ctx->Nr, ctx->E);
+	mont_redc_u64(ctx->length, ctx->M, ctx->n0, ctx->Z);
+	u64_to_array(ctx->length, ctx->Z, length, Z);
+}
+
+// mod_exp_u64_ctx for little endian X, E and Z of ctx->length limbs, read
+// and written in place. The secret modes run over all 64*ctx->length
+// exponent bits.
+void mod_exp_u64_le_ctx(mont_ctx_u64 *ctx, uint32_t mode, uint32_t window,
+		uint64_t *X, uint64_t *E, uint64_t *Z) {
+	mont_exp_u64(ctx, mode, window, 64 * ctx->length, X, ctx->Nr, E);
+	mont_redc_u64(ctx->length, ctx->M, ctx->n0, ctx->Z);
+	copy_u64(ctx->length, ctx->Z, Z);
+}
+
+// The Montgomery domain operations of montgomery_array.h on ctx, with
+// R = 2^(64*ctx->length). A, B, X and Z are length word uint32_t arrays,
+// the ones in the domain hold x * R mod M, reduced below M also with
+// ctx->lazy.
+
+static void mont_canonical_u64(mont_ctx_u64 *ctx, uint64_t *A) {
+	if (ctx->lazy)
+		mont_final_sub_u64(ctx->length, 0, ctx->M, A);
+}
+
+// A := X * R mod M.
+void to_mont_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *X,
+		uint32_t *A) {
+	array_to_u64(length, X, ctx->length, ctx->X);
+	mont_prod_ctx_u64(ctx, ctx->X, ctx->Nr, ctx->Z);
+	mont_canonical_u64(ctx, ctx->Z);
+	u64_to_array(ctx->length, ctx->Z, length, A);
+}
+
+// Z := A / R mod M, a REDC alone.
+void from_mont_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *A,
+		uint32_t *Z) {
+	array_to_u64(length, A, ctx->length, ctx->Z);
+	mont_redc_u64(ctx->length, ctx->M, ctx->n0, ctx->Z);
+	u64_to_array(ctx->length, ctx->Z, length, Z);
+}
+
+// Z := MontProd( A, B ).
+void mont_mul_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *A,
+		uint32_t *B, uint32_t *Z) {
+	array_to_u64(length, A, ctx->length, ctx->X);
+	array_to_u64(length, B, ctx->length, ctx->P);
+	mont_prod_ctx_u64(ctx, ctx->X, ctx->P, ctx->Z);
+	mont_canonical_u64(ctx, ctx->Z);
+	u64_to_array(ctx->length, ctx->Z, length, Z);
+}
+
+// Z := MontProd( A, A ).
+void mont_sqr_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *A,
+		uint32_t *Z) {
+	array_to_u64(length, A, ctx->length, ctx->X);
+	mont_sqr_ctx_u64(ctx, ctx->X, ctx->Z);
+	mont_canonical_u64(ctx, ctx->Z);
+	u64_to_array(ctx->length, ctx->Z, length, Z);
+}
+
+// Z := A ** E in the domain, i.e. without the conversions of
+// mod_exp_u64_ctx. Bringing A in is MontProd( A, Rm ), which leaves it as
+// it is.
+void mont_exp_domain_u64(mont_ctx_u64 *ctx, uint32_t mode, uint32_t window,
+		uint32_t length, uint32_t *A, uint32_t *E, uint32_t *Z) {
+	array_to_u64(length, A, ctx->length, ctx->X);
+	array_to_u64(length, E, ctx->length, ctx->E);
+	mont_exp_u64(ctx, mode, window, 32 * length, ctx->X, ctx->Rm, ctx->E);
+	mont_canonical_u64(ctx, ctx->Z);
+	u64_to_array(ctx->length, ctx->Z, length, Z);
+}
+
+// A := A ** (2^T) in the Montgomery domain, A of ctx->length limbs and
+// less than M on entry and exit. With ctx->lazy the squarings skip the
+// final subtraction and only the last result is reduced.
+void mont_sqr_chain_u64(mont_ctx_u64 *ctx, uint64_t *A, uint64_t T) {
+	for (uint64_t k = 0; k < T; k++)
+		mont_sqr_ctx_u64(ctx, A, A);
+	mont_canonical_u64(ctx, A);
+}
+
+// mont_sqr_chain_u64 on a length word uint32_t A in the domain of
+// mont_exp_domain_u64, Z may overlap A.
+void mont_sqr_chain_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *A,
+		uint64_t T, uint32_t *Z) {
+	array_to_u64(length, A, ctx->length, ctx->X);
+	mont_sqr_chain_u64(ctx, ctx->X, T);
+	u64_to_array(ctx->length, ctx->X, length, Z);
+}
+
+// Z := X[0] ** E[0] * ... * X[count - 1] ** E[count - 1] mod M, see
+// mont_exp_multi_loop_array. X, E and Z are length word uint32_t arrays.
+void mod_exp_multi_u64_ctx(mont_ctx_u64 *ctx, uint32_t length, uint32_t count,
+		uint32_t **X, uint32_t **E, uint32_t *Z) {
+	if ((count == 0) || (count > MONT_MULTI_MAX)) die("count");
+	const uint32_t n = ctx->length;
+	const uint32_t stride = n << (MONT_WINDOW_MAX - 1);
+	uint64_t *table = calloc((size_t) count * stride, sizeof(uint64_t));
+	if (table == NULL) die("calloc");
+	uint32_t window[MONT_MULTI_MAX];
+	uint32_t value[MONT_MULTI_MAX];
+	int32_t lo[MONT_MULTI_MAX];
+	int32_t top = -1;
+	for (uint32_t b = 0; b < count; b++) {
+		uint64_t *t = table + b * stride;
+		const int32_t bits = (int32_t) findN(length, E[b]);
+		window[b] = mont_window_bits_exp(length, E[b]);
+
+		array_to_u64(length, X[b], n, ctx->X);
+		mont_prod_ctx_u64(ctx, ctx->X, ctx->Nr, t);
+		if (window[b] > 1) {
+			mont_sqr_ctx_u64(ctx, t, ctx->P);
+			for (uint32_t k = 1; k < (1u << (window[b] - 1)); k++)
+				mont_prod_ctx_u64(ctx, t + (k - 1) * n, ctx->P, t + k * n);
+		}
+		value[b] = exp_window_array(length, E[b], bits - 1, window[b], &lo[b]);
+		if (bits - 1 > top)
+			top = bits - 1;
+	}
+
+	uint64_t *Z64 = ctx->Z;
+	copy_u64(n, ctx->Rm, Z64);
+	uint32_t started = 0;
+	for (int32_t i = top; i >= 0; i--) {
+		if (started)
+			mont_sqr_ctx_u64(ctx, Z64, Z64);
+		for (uint32_t b = 0; b < count; b++) {
+			if (lo[b] != i)
+				continue;
+			uint64_t *entry = table + b * stride + (value[b] >> 1) * n;
+			if (started) {
+				uint64_t *next = (Z64 == ctx->Z) ? ctx->P : ctx->Z;
+				mont_prod_ctx_u64(ctx, Z64, entry, next);
+				Z64 = next;
+			} else {
+				copy_u64(n, entry, Z64);
+				started = 1;
+			}
+			value[b] = exp_window_array(length, E[b], i - 1, window[b], &lo[b]);
+		}
+	}
+	free(table);
+
+	mont_redc_u64(n, ctx->M, ctx->n0, Z64);
+	u64_to_array(n, Z64, length, Z);
+}
+
+// 64 bit limb version of mod_exp_public_array.
+void mod_exp_public_u64(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
+		uint32_t *Z) {
+	const uint32_t n = U64_LENGTH(length);
+	uint64_t *M64 = calloc(n, sizeof(uint64_t));
+	uint64_t *P = calloc(n, sizeof(uint64_t));
+	uint64_t *Z64 = calloc(2 * n, sizeof(uint64_t));
+	uint64_t *temp = calloc(2 * n, sizeof(uint64_t));
+	if (M64 == NULL) die("calloc");
+	if (P == NULL) die("calloc");
+	if (Z64 == NULL) die("calloc");
+	if (temp == NULL) die("calloc");
+
+	const uint32_t bits = findN(length, E);
+	array_to_u64(length, M, n, M64);
+	const uint64_t n0 = mont_n0_u64(n, M64);
+	if (bits == 0) {
+		uint32_t one[] = { 1 };
+		mod_shift_u64(1, one, 0, length, M, n, Z64);
+	} else {
+		// P := X * R mod M
+		mod_shift_u64(length, X, n, length, M, n, P);
+		// The power moves between the two halves of Z64.
+		uint64_t *z = Z64;
+		copy_u64(n, P, z);
+		for (int32_t i = ((int32_t) bits) - 2; i >= 0; i--) {
+			mont_sqr_u64(n, z, M64, n0, temp, z);
+			if (exp_bit_array(length, E, (uint32_t) i)) {
+				uint64_t *next = (z == Z64) ? Z64 + n : Z64;
+				mont_prod_u64(n, z, P, M64, n0, next);
+				z = next;
+			}
+		}
+		mont_redc_u64(n, M64, n0, z);
+		if (z != Z64)
+			copy_u64(n, z, Z64);
+	}
+	u64_to_array(n, Z64, length, Z);
+
+	free(M64);
+	free(P);
+	free(Z64);
+	free(temp);
+}
+
+#endif /* MONT_HAVE_UINT64 */
@@ -0,0 +1,125 @@
+/*
+ * montgomery_uint64_t.h
+ *
+ *  64 bit limb Montgomery backend. The kernels mirror the uint32_t ones in
+ *  montgomery_array.h with R = 2^(64*length) on little endian limbs, see
+ *  bignum_uint64_t.h. mod_exp_u64_ctx and the other mod_exp entry points
+ *  take and return the usual big endian uint32_t arrays, mod_exp_u64_le_ctx
+ *  little endian limbs as they are.
+ *  Only available where the compiler has unsigned __int128.
+ */
+
+#ifndef MONTGOMERY_UINT64_T_H_
+#define MONTGOMERY_UINT64_T_H_
+
+#include <stddef.h>
+#include "bignum_uint64_t.h"
+
+#ifdef MONT_HAVE_UINT64
+
+uint64_t mont_n0_u64(uint32_t length, uint64_t *M);
+void mont_prod_u64(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+		uint64_t n0, uint64_t *s);
+void mont_redc_u64(uint32_t length, uint64_t *M, uint64_t n0, uint64_t *s);
+void mont_redc_wide_u64(uint32_t length, uint64_t *M, uint64_t n0, uint64_t *t,
+		uint64_t *s);
+void mont_redc_wide_lazy_u64(uint32_t length, uint64_t *M, uint64_t n0,
+		uint64_t *t, uint64_t *s);
+void mont_sqr_u64(uint32_t length, uint64_t *A, uint64_t *M, uint64_t n0,
+		uint64_t *t, uint64_t *s);
+void mont_prod_lazy_u64(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s);
+void mont_prod_u64_portable(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s);
+void mont_prod_lazy_u64_portable(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s);
+void mont_prod_u64_adx(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+		uint64_t n0, uint64_t *s);
+void mont_prod_lazy_u64_adx(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *s);
+void mont_sqr_u64_portable(uint32_t length, uint64_t *A, uint64_t *M,
+		uint64_t n0, uint64_t *t, uint64_t *s);
+void mont_sqr_lazy_u64(uint32_t length, uint64_t *A, uint64_t *M, uint64_t n0,
+		uint64_t *t, uint64_t *s);
+void mont_sqr_lazy_u64_portable(uint32_t length, uint64_t *A, uint64_t *M,
+		uint64_t n0, uint64_t *t, uint64_t *s);
+void mont_prod_karatsuba_u64(uint32_t length, uint64_t *A, uint64_t *B,
+		uint64_t *M, uint64_t n0, uint64_t *t, uint64_t *w, uint64_t *s);
+void mont_sqr_karatsuba_u64(uint32_t length, uint64_t *A, uint64_t *M,
+		uint64_t n0, uint64_t *t, uint64_t *w, uint64_t *s);
+
+// Modulus length in limbs from which mont_ctx_u64 uses the Karatsuba
+// products with a separate REDC instead of the interleaved kernels.
+// Secret mode exponentiations, best of ten, portable kernels:
+//   limbs          128    132    144    160    256
+//   interleaved   398 ms 420 ms 600 ms 924 ms 3.68 s
+//   Karatsuba     497 ms 415 ms 719 ms 825 ms 3.24 s
+// The ADX product is ahead of both up to MONT_ADX_MAX_LIMBS.
+#define MONT_KARATSUBA_LIMBS 160
+
+// 64 bit limb state for one modulus, length is in 64 bit limbs. All
+// buffers are length limbs except temp2 and wide (2*length), table and
+// kara, the mul_karatsuba_u64 scratch. prod, prod_lazy, sqr and sqr_lazy
+// are the dispatched kernels, fixed when the context is made so that a
+// later mont_dispatch_init does not change them. karatsuba is set where the
+// Karatsuba products are used. lazy, set where 4M < R, keeps the values of
+// the exponentiation loops in [0, 2M) with one reduction at the end
+// instead of a final subtraction after every product.
+typedef struct mont_ctx_u64 {
+	uint32_t length;
+	uint32_t karatsuba;
+	uint32_t lazy;
+	uint64_t n0;
+	void (*prod)(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+			uint64_t n0, uint64_t *s);
+	void (*prod_lazy)(uint32_t length, uint64_t *A, uint64_t *B, uint64_t *M,
+			uint64_t n0, uint64_t *s);
+	void (*sqr)(uint32_t length, uint64_t *A, uint64_t *M, uint64_t n0,
+			uint64_t *t, uint64_t *s);
+	void (*sqr_lazy)(uint32_t length, uint64_t *A, uint64_t *M, uint64_t n0,
+			uint64_t *t, uint64_t *s);
+	uint64_t *M;
+	uint64_t *Nr;
+	uint64_t *Rm;
+	uint64_t *X;
+	uint64_t *E;
+	uint64_t *P;
+	uint64_t *Z;
+	uint64_t *temp2;
+	uint64_t *table;
+	uint64_t *wide;
+	uint64_t *kara;
+} mont_ctx_u64;
+
+void mont_table_select_u64(uint32_t length, uint64_t *table,
+		uint32_t entries, uint32_t index, uint64_t *dst);
+size_t mont_ctx_u64_words(uint32_t length);
+void mont_ctx_u64_init(mont_ctx_u64 *ctx, uint32_t length, uint32_t *M,
+		uint64_t *buf, uint32_t *temp);
+mont_ctx_u64 *mont_ctx_u64_new(uint32_t length, uint32_t *M);
+void mont_ctx_u64_free(mont_ctx_u64 *ctx);
+void mod_exp_u64_ctx(mont_ctx_u64 *ctx, uint32_t mode, uint32_t window,
+		uint32_t length, uint32_t *X, uint32_t *E, uint32_t *Z);
+void mod_exp_u64_le_ctx(mont_ctx_u64 *ctx, uint32_t mode, uint32_t window,
+		uint64_t *X, uint64_t *E, uint64_t *Z);
+void to_mont_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *X,
+		uint32_t *A);
+void from_mont_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *A,
+		uint32_t *Z);
+void mont_mul_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *A,
+		uint32_t *B, uint32_t *Z);
+void mont_sqr_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *A,
+		uint32_t *Z);
+void mont_exp_domain_u64(mont_ctx_u64 *ctx, uint32_t mode, uint32_t window,
+		uint32_t length, uint32_t *A, uint32_t *E, uint32_t *Z);
+void mont_sqr_chain_u64(mont_ctx_u64 *ctx, uint64_t *A, uint64_t T);
+void mont_sqr_chain_domain_u64(mont_ctx_u64 *ctx, uint32_t length, uint32_t *A,
+		uint64_t T, uint32_t *Z);
+void mod_exp_multi_u64_ctx(mont_ctx_u64 *ctx, uint32_t length, uint32_t count,
+		uint32_t **X, uint32_t **E, uint32_t *Z);
+void mod_exp_public_u64(uint32_t length, uint32_t *X, uint32_t *E, uint32_t *M,
+		uint32_t *Z);
+
+#endif /* MONT_HAVE_UINT64 */
+
+#endif /* MONTGOMERY_UINT64_T_H_ */